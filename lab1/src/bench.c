@@ -0,0 +1,408 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define BUFFER_SIZE 1024
+#define GEN_BUFFER_SIZE (1024 * 1024)
+#define LINE_BUFFER_SIZE (2 * BUFFER_SIZE)
+#define MAX_MODES 32
+#define MAX_MODE_ARGS 16
+
+// Замер конвейера parent/child из lab1.
+//   ./bench gen [-s РАЗМЕР] [-l ДЛИНА_СТРОКИ] [-d ДЕЛИТЕЛЕЙ] [-x SEED] <файл>
+//       создаёт синтетический вход заданного размера (суффиксы K, M, G);
+//   ./bench run [-m "ФЛАГИ parent"]... [-n ПОВТОРОВ] [-p ПУТЬ_К_PARENT] <файл>
+//       запускает parent без запроса имени файла и печатает по строке JSON на каждый прогон.
+// Системные вызовы считаются все (splice/tee, io_uring_enter и прочие) счётчиком perf на точке трассировки
+// raw_syscalls:sys_enter, который наследуют parent и все его child. Если tracefs или perf недоступны,
+// берутся syscr/syscw из /proc/<pid>/io -- только read/write-семейство; источник указан в syscall_source.
+// Переключения контекста -- по rusage parent вместе с его child.
+
+void HandleError(const char *message) {
+    write(STDERR_FILENO, message, strlen(message));
+    exit(EXIT_FAILURE);
+}
+
+uint64_t SplitMix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+unsigned long long ParseSize(const char *text) {
+    char *suffix;
+    unsigned long long value = strtoull(text, &suffix, 10);
+
+    switch (*suffix) {
+        case 'G': case 'g': value <<= 30; break;
+        case 'M': case 'm': value <<= 20; break;
+        case 'K': case 'k': value <<= 10; break;
+        case '\0': break;
+        default: HandleError("Ошибка: размер задаётся числом с суффиксом K, M или G.\n");
+    }
+    return value;
+}
+
+// Число из width цифр без ведущего нуля; знак случайный.
+int AppendNumber(char *out, int width, uint64_t *rng) {
+    int len = 0;
+    uint64_t random = SplitMix64(rng);
+
+    if (random & 1) {
+        out[len++] = '-';
+    }
+    out[len++] = '1' + (random >> 1) % 9;
+    for (int i = 1; i < width; i++) {
+        out[len++] = '0' + SplitMix64(rng) % 10;
+    }
+    return len;
+}
+
+int Generate(int argc, char **argv) {
+    unsigned long long size = 64ULL << 20;
+    int line_len = 40;
+    int divisors = 4;
+    uint64_t rng = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:l:d:x:")) != -1) {
+        switch (opt) {
+            case 's': size = ParseSize(optarg); break;
+            case 'l': line_len = atoi(optarg); break;
+            case 'd': divisors = atoi(optarg); break;
+            case 'x': rng = strtoull(optarg, NULL, 10); break;
+            default: HandleError("Использование: ./bench gen [-s РАЗМЕР] [-l ДЛИНА] [-d ДЕЛИТЕЛЕЙ] [-x SEED] <файл>\n");
+        }
+    }
+    if (optind >= argc || divisors < 0 || divisors >= BUFFER_SIZE || line_len < 1 || line_len >= BUFFER_SIZE) {
+        HandleError("Ошибка: неверные параметры генерации.\n");
+    }
+
+    // Ширина чисел подбирается под длину строки; недостающее добивается пробелами в конце строки.
+    int digits = (line_len - divisors * 2) / (divisors + 1);
+    if (digits < 1) digits = 1;
+    if (digits > 9) digits = 9;
+
+    // Самая длинная строка: все числа со знаком, пробелы между ними и перевод строки.
+    if ((divisors + 1) * (digits + 1) + divisors + 1 > LINE_BUFFER_SIZE) {
+        HandleError("Ошибка: слишком много делителей для одной строки.\n");
+    }
+
+    int fd = open(argv[optind], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        HandleError("Ошибка создания файла.\n");
+    }
+
+    char *buffer = malloc(GEN_BUFFER_SIZE);
+    if (buffer == NULL) {
+        HandleError("Ошибка выделения памяти.\n");
+    }
+
+    unsigned long long written = 0;
+    unsigned long long lines = 0;
+    size_t filled = 0;
+
+    while (written + filled < size) {
+        char line[LINE_BUFFER_SIZE];
+        int len = AppendNumber(line, digits, &rng);
+        for (int i = 0; i < divisors; i++) {
+            line[len++] = ' ';
+            len += AppendNumber(line + len, digits, &rng);
+        }
+        while (len < line_len) {
+            line[len++] = ' ';
+        }
+        line[len++] = '\n';
+
+        if (filled + len > GEN_BUFFER_SIZE) {
+            if (write(fd, buffer, filled) != (ssize_t)filled) {
+                HandleError("Ошибка записи файла.\n");
+            }
+            written += filled;
+            filled = 0;
+        }
+        memcpy(buffer + filled, line, len);
+        filled += len;
+        lines++;
+    }
+    if (write(fd, buffer, filled) != (ssize_t)filled) {
+        HandleError("Ошибка записи файла.\n");
+    }
+    written += filled;
+
+    printf("{\"file\":\"%s\",\"bytes\":%llu,\"lines\":%llu,\"line_len\":%d,\"divisors\":%d}\n",
+           argv[optind], written, lines, line_len, divisors);
+
+    free(buffer);
+    close(fd);
+    return EXIT_SUCCESS;
+}
+
+unsigned long long CountLines(const char *path, unsigned long long *bytes) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1) {
+        HandleError("Ошибка открытия входного файла.\n");
+    }
+
+    *bytes = st.st_size;
+    unsigned long long lines = 0;
+    if (st.st_size > 0) {
+        char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            HandleError("Ошибка отображения входного файла.\n");
+        }
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+        const char *current = data;
+        const char *end = data + st.st_size;
+        while ((current = memchr(current, '\n', end - current)) != NULL) {
+            lines++;
+            current++;
+        }
+        if (data[st.st_size - 1] != '\n') {
+            lines++;
+        }
+        munmap(data, st.st_size);
+    }
+    close(fd);
+    return lines;
+}
+
+// Считывает syscr + syscw завершившегося процесса, пока он ещё не убран wait.
+// В счётчики уже вошли все child, которых этот процесс дождался.
+unsigned long long ReadSyscalls(pid_t pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/io", (int)pid);
+
+    FILE *io = fopen(path, "r");
+    if (io == NULL) {
+        return 0;
+    }
+
+    unsigned long long total = 0, value;
+    char key[64];
+    while (fscanf(io, "%63[^:]: %llu\n", key, &value) == 2) {
+        if (strcmp(key, "syscr") == 0 || strcmp(key, "syscw") == 0) {
+            total += value;
+        }
+    }
+    fclose(io);
+    return total;
+}
+
+// Номер точки трассировки raw_syscalls:sys_enter; -1, если tracefs не смонтирован.
+long long SyscallTracepointId(void) {
+    const char *paths[] = {"/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+                           "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id"};
+
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+        FILE *file = fopen(paths[i], "r");
+        long long id;
+        if (file == NULL) {
+            continue;
+        }
+        int parsed = fscanf(file, "%lld", &id);
+        fclose(file);
+        if (parsed == 1) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+// Счётчик входов в системные вызовы процесса pid и всех, кого он породит после открытия счётчика.
+// Включается при exec, поэтому подготовка bench между fork и exec в счёт не попадает.
+int OpenSyscallCounter(pid_t pid) {
+    long long id = SyscallTracepointId();
+    if (id < 0) {
+        return -1;
+    }
+
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_TRACEPOINT;
+    attr.config = id;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.enable_on_exec = 1;
+    return syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+// Строка в JSON: кавычки, обратная косая черта и управляющие символы экранируются.
+void PrintJsonString(const char *text) {
+    putchar('"');
+    for (const unsigned char *c = (const unsigned char *)text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            printf("\\%c", *c);
+        } else if (*c < 0x20) {
+            printf("\\u%04x", *c);
+        } else {
+            putchar(*c);
+        }
+    }
+    putchar('"');
+}
+
+void RunOnce(const char *parent_path, const char *mode, const char *path, int run,
+             unsigned long long bytes, unsigned long long lines) {
+    char mode_copy[BUFFER_SIZE];
+    char *args[MAX_MODE_ARGS + 3];
+    int arg_count = 0;
+
+    strncpy(mode_copy, mode, sizeof(mode_copy) - 1);
+    mode_copy[sizeof(mode_copy) - 1] = '\0';
+    args[arg_count++] = (char *)parent_path;
+    for (char *token = strtok(mode_copy, " "); token && arg_count < MAX_MODE_ARGS; token = strtok(NULL, " ")) {
+        args[arg_count++] = token;
+    }
+    args[arg_count++] = (char *)path;
+    args[arg_count] = NULL;
+
+    struct timespec start, finish;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // child ждёт на канале, пока bench не откроет на нём счётчик, и только потом делает exec.
+    int start_pipe[2];
+    if (pipe(start_pipe) == -1) {
+        HandleError("Ошибка создания канала.\n");
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        HandleError("Ошибка создания процесса.\n");
+    }
+    if (pid == 0) {
+        char go;
+        close(start_pipe[1]);
+        if (read(start_pipe[0], &go, 1) != 1) {
+            _exit(EXIT_FAILURE);
+        }
+        close(start_pipe[0]);
+
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd == -1 || dup2(null_fd, STDOUT_FILENO) == -1) {
+            HandleError("Ошибка перенаправления вывода.\n");
+        }
+        execv(parent_path, args);
+        HandleError("Ошибка запуска parent.\n");
+    }
+
+    int counter = OpenSyscallCounter(pid);
+    close(start_pipe[0]);
+    if (write(start_pipe[1], "", 1) != 1) {
+        HandleError("Ошибка запуска parent.\n");
+    }
+    close(start_pipe[1]);
+
+    siginfo_t info;
+    if (waitid(P_PID, pid, &info, WEXITED | WNOWAIT) == -1) {
+        HandleError("Ошибка ожидания parent.\n");
+    }
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+    // Счётчик читается, когда parent уже завершился: значения его child сложены в общий итог.
+    unsigned long long syscalls = 0;
+    const char *syscall_source = "tracepoint";
+    if (counter == -1 || read(counter, &syscalls, sizeof(syscalls)) != sizeof(syscalls)) {
+        syscalls = ReadSyscalls(pid);
+        syscall_source = "rw_only";
+    }
+    if (counter != -1) {
+        close(counter);
+    }
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) == -1) {
+        HandleError("Ошибка ожидания parent.\n");
+    }
+
+    double seconds = (finish.tv_sec - start.tv_sec) + (finish.tv_nsec - start.tv_nsec) / 1e9;
+    double megabytes = bytes / (1024.0 * 1024.0);
+    long switches = usage.ru_nvcsw + usage.ru_nivcsw;
+
+    printf("{\"mode\":");
+    PrintJsonString(mode);
+    printf(",\"run\":%d,\"bytes\":%llu,\"lines\":%llu,\"seconds\":%.6f,"
+           "\"lines_per_s\":%.1f,\"mb_per_s\":%.2f,\"syscalls\":%llu,\"syscalls_per_mb\":%.2f,"
+           "\"syscall_source\":\"%s\",\"ctx_switches\":%ld,\"ctx_switches_per_mb\":%.2f,"
+           "\"user_s\":%.6f,\"sys_s\":%.6f,\"exit_status\":%d}\n",
+           run, bytes, lines, seconds,
+           lines / seconds, megabytes / seconds, syscalls, megabytes > 0 ? syscalls / megabytes : 0.0,
+           syscall_source, switches, megabytes > 0 ? switches / megabytes : 0.0,
+           usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6,
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6,
+           WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+    fflush(stdout);
+}
+
+int Run(int argc, char **argv) {
+    const char *modes[MAX_MODES];
+    int mode_count = 0;
+    int repeats = 3;
+    const char *parent_path = "./parent";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:n:p:")) != -1) {
+        switch (opt) {
+            case 'm':
+                if (mode_count == MAX_MODES) {
+                    HandleError("Ошибка: слишком много режимов.\n");
+                }
+                modes[mode_count++] = optarg;
+                break;
+            case 'n': repeats = atoi(optarg); break;
+            case 'p': parent_path = optarg; break;
+            default: HandleError("Использование: ./bench run [-m \"ФЛАГИ\"]... [-n ПОВТОРОВ] [-p PARENT] <файл>\n");
+        }
+    }
+    if (optind >= argc || repeats < 1) {
+        HandleError("Ошибка: неверные параметры запуска.\n");
+    }
+
+    if (mode_count == 0) {
+        modes[mode_count++] = "";
+        modes[mode_count++] = "-z";
+        modes[mode_count++] = "-b";
+        modes[mode_count++] = "-a";
+    }
+
+    unsigned long long bytes;
+    unsigned long long lines = CountLines(argv[optind], &bytes);
+
+    for (int m = 0; m < mode_count; m++) {
+        for (int run = 1; run <= repeats; run++) {
+            RunOnce(parent_path, modes[m], argv[optind], run, bytes, lines);
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        HandleError("Использование: ./bench gen|run ...\n");
+    }
+
+    optind = 2;
+    if (strcmp(argv[1], "gen") == 0) {
+        return Generate(argc, argv);
+    }
+    if (strcmp(argv[1], "run") == 0) {
+        return Run(argc, argv);
+    }
+    HandleError("Ошибка: неизвестная команда, ожидается gen или run.\n");
+    return EXIT_FAILURE;
+}
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -5,110 +6,1015 @@
 #include <errno.h>
 #include <stdio.h>
 #include <limits.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "protocol.h"
+#include "uring.h"
 
 #define BUFFER_SIZE 1024
+#define READ_CHUNK_SIZE (1 << 20)
+#define OUTPUT_BLOCK_SIZE (64 * 1024)
+#define DEFAULT_FLUSH_WATERMARK (256 * 1024)
+#define URING_ENTRIES 64
+#define URING_READ_BUFFERS 4
+#define URING_WRITE_BUFFERS 4
+#define CACHE_SLOT_SIZE 256
+#define CACHE_WAYS 4
+#define CACHE_MAX_KEY 128
+
+// Отформатированные строки копятся в блоках и сбрасываются одним writev на каждый дескриптор,
+// когда накопится watermark байт, поэтому число системных вызовов не зависит от числа строк.
+typedef struct {
+    struct iovec *blocks;
+    size_t block_size;
+    int max_blocks;
+    int count;
+    size_t pending;
+    size_t watermark;
+} OutputBatch;
+
+int output_fd = -1;
+OutputBatch output_batch;
+int binary_output = 0;
+
+// Пары (делитель, частное) текущей строки; массив растёт под самую длинную строку.
+RecordPair *line_pairs;
+size_t line_pairs_capacity;
+
+void FinishOutput(void);
 
 void HandleError(const char *message) {
+    static int handling_error = 0;
+
+    if (!handling_error) {
+        handling_error = 1;
+        FinishOutput();
+    }
     write(STDERR_FILENO, message, strlen(message));
     exit(EXIT_FAILURE);
 }
 
-int safe_strtol(const char *str, char **endptr) {
-    long value = strtol(str, endptr, 10);
+void InitOutput(size_t watermark) {
+    output_batch.watermark = watermark;
+    output_batch.block_size = OUTPUT_BLOCK_SIZE;
+    output_batch.max_blocks = watermark / OUTPUT_BLOCK_SIZE + 1;
+    if (output_batch.max_blocks > IOV_MAX) {
+        output_batch.max_blocks = IOV_MAX;
+    }
+
+    output_batch.blocks = calloc(output_batch.max_blocks, sizeof(struct iovec));
+    if (output_batch.blocks == NULL) {
+        HandleError("Ошибка выделения памяти для буфера вывода.\n");
+    }
+    for (int i = 0; i < output_batch.max_blocks; i++) {
+        output_batch.blocks[i].iov_base = malloc(OUTPUT_BLOCK_SIZE);
+        if (output_batch.blocks[i].iov_base == NULL) {
+            HandleError("Ошибка выделения памяти для буфера вывода.\n");
+        }
+    }
+    output_batch.count = 1;
+}
+
+void WritevAll(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if (written == -1) {
+            output_batch.count = 0;
+            HandleError("Ошибка записи результата.\n");
+        }
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+void UringFlushOutput(void);
+void UringDrainWrites(void);
+int uring_active = 0;
+
+void FlushOutput(void) {
+    if (output_batch.pending == 0) {
+        return;
+    }
+    if (uring_active) {
+        UringFlushOutput();
+        return;
+    }
+
+    // writev сдвигает копию iovec при частичной записи, сами блоки остаются на месте.
+    struct iovec iov[output_batch.count];
+
+    memcpy(iov, output_batch.blocks, sizeof(iov));
+    WritevAll(STDOUT_FILENO, iov, output_batch.count);
+    if (output_fd != -1) {
+        memcpy(iov, output_batch.blocks, sizeof(iov));
+        WritevAll(output_fd, iov, output_batch.count);
+    }
+
+    for (int i = 0; i < output_batch.count; i++) {
+        output_batch.blocks[i].iov_len = 0;
+    }
+    output_batch.count = 1;
+    output_batch.pending = 0;
+}
+
+// Сбрасывает всё накопленное и дожидается окончания записи перед выходом из процесса.
+void FinishOutput(void) {
+    FlushOutput();
+    if (uring_active) {
+        UringDrainWrites();
+    }
+}
+
+// Возвращает место под строку длиной до len байт в текущем блоке.
+char *ReserveOutput(size_t len) {
+    struct iovec *block = &output_batch.blocks[output_batch.count - 1];
+
+    if (output_batch.block_size - block->iov_len < len) {
+        if (output_batch.count == output_batch.max_blocks) {
+            FlushOutput();
+        } else {
+            output_batch.count++;
+        }
+        block = &output_batch.blocks[output_batch.count - 1];
+    }
+    return (char *)block->iov_base + block->iov_len;
+}
+
+void CommitOutput(size_t len) {
+    output_batch.blocks[output_batch.count - 1].iov_len += len;
+    output_batch.pending += len;
+    if (output_batch.pending >= output_batch.watermark) {
+        FlushOutput();
+    }
+}
+
+// Разбор числа без strtol. Как и strtol, при отсутствии цифр возвращает 0 и не сдвигает курсор.
+int ParseInt(const char **cursor, const char *end) {
+    const char *current = *cursor;
+    int negative = 0;
+
+    if (current < end && (*current == '-' || *current == '+')) {
+        negative = (*current == '-');
+        current++;
+    }
+
+    const char *digits = current;
+    unsigned long long value = 0;
+    while (current < end && (unsigned char)(*current - '0') < 10) {
+        if (value <= (unsigned long long)INT_MAX + 1) {
+            value = value * 10 + (unsigned char)(*current - '0');
+        }
+        current++;
+    }
+
+    if (current == digits) {
+        return 0;
+    }
 
-    if (value > INT_MAX || value < INT_MIN) {
+    if (value > (unsigned long long)INT_MAX + negative) {
         HandleError("Ошибка: значение выходит за пределы допустимого диапазона int.\n");
     }
-    return (int)value;
+
+    *cursor = current;
+    return (int)(negative ? -(long long)value : (long long)value);
 }
 
-int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        HandleError("Ошибка: необходимо указать путь к файлу.\n");
+void ReportDivisionByZero(int dividend) {
+    FinishOutput();
+
+    if (binary_output) {
+        RecordHeader header = {sizeof(RecordHeader), RECORD_DIVISION_BY_ZERO, dividend, 0};
+        write(STDOUT_FILENO, &header, sizeof(header));
+    } else {
+        const char *message = "Ошибка: деление на ноль.\n";
+        write(STDOUT_FILENO, message, strlen(message));
     }
 
-    int file = open(argv[1], O_RDONLY);
-    if (file == -1) {
-        char error_msg[BUFFER_SIZE];
-        snprintf(error_msg, sizeof(error_msg), "Ошибка открытия файла '%s': %s\n", argv[1], strerror(errno));
-        HandleError(error_msg);
+    if (output_fd != -1) {
+        close(output_fd);
     }
+    exit(EXIT_FAILURE);
+}
 
-    int output_fd = open("output.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
-    if (output_fd == -1) {
-        HandleError("Ошибка создания файла output.txt.\n");
+// Быстрое форматирование результата вместо snprintf: литералы копируются целиком, числа -- по две цифры
+// за шаг. Всё, что не помещается до limit, отбрасывается, как при усечении у snprintf.
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+char *AppendText(char *out, const char *limit, const char *text, size_t len) {
+    if (len > (size_t)(limit - out)) {
+        len = limit - out;
     }
+    memcpy(out, text, len);
+    return out + len;
+}
 
-    if (dup2(file, STDIN_FILENO) == -1) {
-        HandleError("Ошибка перенаправления ввода.\n");
+char *AppendInt(char *out, const char *limit, int value) {
+    char digits[12];
+    char *cursor = digits + sizeof(digits);
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+
+    while (magnitude >= 100) {
+        unsigned int pair = (magnitude % 100) * 2;
+        magnitude /= 100;
+        cursor -= 2;
+        memcpy(cursor, digit_pairs + pair, 2);
+    }
+    if (magnitude >= 10) {
+        cursor -= 2;
+        memcpy(cursor, digit_pairs + magnitude * 2, 2);
+    } else {
+        *--cursor = '0' + magnitude;
+    }
+    if (value < 0) {
+        *--cursor = '-';
+    }
+
+    return AppendText(out, limit, cursor, digits + sizeof(digits) - cursor);
+}
+
+// Форматирует строку в зарезервированное место вывода и возвращает её длину; фиксирует её вызывающий.
+size_t EmitText(int dividend, const RecordPair *pairs, size_t count, char **emitted) {
+    char *output = ReserveOutput(BUFFER_SIZE);
+    const char *limit = output + BUFFER_SIZE - 2;
+    char *cursor = AppendText(output, limit, "Число: ", sizeof("Число: ") - 1);
+    cursor = AppendInt(cursor, limit, dividend);
+
+    for (size_t i = 0; i < count && cursor < limit; i++) {
+        cursor = AppendText(cursor, limit, ", ", 2);
+        cursor = AppendInt(cursor, limit, dividend);
+        cursor = AppendText(cursor, limit, " / ", 3);
+        cursor = AppendInt(cursor, limit, pairs[i].divisor);
+        cursor = AppendText(cursor, limit, " = ", 3);
+        cursor = AppendInt(cursor, limit, pairs[i].quotient);
+    }
+    *cursor++ = '\n';
+
+    *emitted = output;
+    return cursor - output;
+}
+
+// То же для двоичной записи. Запись больше блока вывода отправляется сразу, тогда возвращается 0.
+size_t EmitRecord(int dividend, const RecordPair *pairs, size_t count, char **emitted) {
+    size_t pairs_len = count * sizeof(RecordPair);
+    RecordHeader header = {sizeof(RecordHeader) + pairs_len, RECORD_RESULT, dividend, count};
+
+    if (header.length > OUTPUT_BLOCK_SIZE) {
+        struct iovec iov[2] = {{&header, sizeof(header)}, {(void *)pairs, pairs_len}};
+        FinishOutput();
+        WritevAll(STDOUT_FILENO, iov, 2);
+        return 0;
+    }
+
+    char *output = ReserveOutput(header.length);
+    memcpy(output, &header, sizeof(header));
+    memcpy(output + sizeof(header), pairs, pairs_len);
+
+    *emitted = output;
+    return header.length;
+}
+
+// Кэш готового вывода для повторяющихся строк (-c БАЙТ). Ключ -- нормализованная строка: токены через
+// один пробел. Одинаковый ключ всегда даёт одинаковый вывод, поэтому при попадании разбор, деление и
+// форматирование пропускаются. Память фиксирована: наборы по CACHE_WAYS слотов, вытесняется самый давний.
+typedef struct {
+    uint64_t hash;
+    uint32_t stamp;
+    uint16_t key_len;
+    uint16_t value_len;
+    char data[CACHE_SLOT_SIZE - 16];
+} CacheSlot;
+
+typedef struct {
+    CacheSlot *slots;
+    size_t set_mask;
+    uint32_t clock;
+    unsigned long long lookups;
+    unsigned long long hits;
+    unsigned long long stores;
+    unsigned long long evictions;
+} LineCache;
+
+LineCache line_cache;
+
+void ReportCacheStats(void) {
+    char report[BUFFER_SIZE];
+    int report_len = snprintf(report, sizeof(report),
+                              "[CACHE] Обращений: %llu, попаданий: %llu (%.1f%%), записей: %llu, вытеснений: %llu, слотов: %zu\n",
+                              line_cache.lookups, line_cache.hits,
+                              line_cache.lookups ? 100.0 * line_cache.hits / line_cache.lookups : 0.0,
+                              line_cache.stores, line_cache.evictions, (line_cache.set_mask + 1) * CACHE_WAYS);
+    write(STDERR_FILENO, report, report_len);
+}
+
+void InitCache(size_t budget) {
+    size_t sets = budget / (sizeof(CacheSlot) * CACHE_WAYS);
+    if (sets == 0) {
+        HandleError("Ошибка: бюджет кэша меньше одного набора слотов.\n");
+    }
+
+    // Число наборов округляется вниз до степени двойки, чтобы набор выбирался маской.
+    size_t set_count = 1;
+    while (set_count * 2 <= sets) {
+        set_count *= 2;
+    }
+
+    line_cache.slots = calloc(set_count * CACHE_WAYS, sizeof(CacheSlot));
+    if (line_cache.slots == NULL) {
+        HandleError("Ошибка выделения памяти для кэша.\n");
+    }
+    line_cache.set_mask = set_count - 1;
+    atexit(ReportCacheStats);
+}
+
+// Строит нормализованный ключ и его хэш (FNV-1a). Возвращает 0, если ключ длиннее CACHE_MAX_KEY.
+int NormalizeLine(const char *current, const char *end, char *key, size_t *key_len, uint64_t *hash) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    size_t len = 0;
+    int separator = 0;
+
+    for (; current < end; current++) {
+        unsigned char c = *current;
+        if (c == ' ' || c == '\t') {
+            separator = 1;
+            continue;
+        }
+        if (len + separator >= CACHE_MAX_KEY) {
+            return 0;
+        }
+        if (separator) {
+            key[len++] = ' ';
+            h = (h ^ ' ') * 0x100000001b3ULL;
+            separator = 0;
+        }
+        key[len++] = c;
+        h = (h ^ c) * 0x100000001b3ULL;
+    }
+
+    *key_len = len;
+    *hash = h;
+    return 1;
+}
+
+CacheSlot *CacheLookup(uint64_t hash, const char *key, size_t key_len) {
+    CacheSlot *set = &line_cache.slots[(hash & line_cache.set_mask) * CACHE_WAYS];
+
+    line_cache.lookups++;
+    for (int way = 0; way < CACHE_WAYS; way++) {
+        CacheSlot *slot = &set[way];
+        if (slot->key_len == key_len && slot->hash == hash && memcmp(slot->data, key, key_len) == 0) {
+            slot->stamp = ++line_cache.clock;
+            line_cache.hits++;
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+void CacheStore(uint64_t hash, const char *key, size_t key_len, const char *value, size_t value_len) {
+    if (key_len + value_len > sizeof(((CacheSlot *)0)->data)) {
+        return;
+    }
+
+    CacheSlot *set = &line_cache.slots[(hash & line_cache.set_mask) * CACHE_WAYS];
+    CacheSlot *victim = &set[0];
+    for (int way = 0; way < CACHE_WAYS; way++) {
+        if (set[way].key_len == 0) {
+            victim = &set[way];
+            break;
+        }
+        if (set[way].stamp < victim->stamp) {
+            victim = &set[way];
+        }
+    }
+
+    if (victim->key_len != 0) {
+        line_cache.evictions++;
+    }
+    victim->hash = hash;
+    victim->stamp = ++line_cache.clock;
+    victim->key_len = key_len;
+    victim->value_len = value_len;
+    memcpy(victim->data, key, key_len);
+    memcpy(victim->data + key_len, value, value_len);
+    line_cache.stores++;
+}
+
+// Обрабатывает одну строку [current, end) без завершающего '\n'.
+void ProcessLine(const char *current, const char *end) {
+    while (current < end && (*current == ' ' || *current == '\t')) {
+        current++;
+    }
+    if (current == end) {
+        return;
+    }
+
+    char key[CACHE_MAX_KEY];
+    size_t key_len;
+    uint64_t hash;
+    int cacheable = 0;
+
+    if (line_cache.slots != NULL && NormalizeLine(current, end, key, &key_len, &hash)) {
+        CacheSlot *slot = CacheLookup(hash, key, key_len);
+        if (slot != NULL) {
+            char *output = ReserveOutput(slot->value_len);
+            memcpy(output, slot->data + slot->key_len, slot->value_len);
+            CommitOutput(slot->value_len);
+            return;
+        }
+        cacheable = 1;
+    }
+
+    int original_number = ParseInt(&current, end);
+    size_t count = 0;
+
+    while (1) {
+        while (current < end && (*current == ' ' || *current == '\t')) {
+            current++;
+        }
+
+        if (current >= end) {
+            break;
+        }
+
+        int next_number = ParseInt(&current, end);
+        if (next_number == 0) {
+            ReportDivisionByZero(original_number);
+        }
+
+        if (count == line_pairs_capacity) {
+            line_pairs_capacity = line_pairs_capacity ? line_pairs_capacity * 2 : 64;
+            line_pairs = realloc(line_pairs, line_pairs_capacity * sizeof(RecordPair));
+            if (line_pairs == NULL) {
+                HandleError("Ошибка выделения памяти для строки.\n");
+            }
+        }
+        line_pairs[count].divisor = next_number;
+        line_pairs[count].quotient = original_number / next_number;
+        count++;
+    }
+
+    char *emitted;
+    size_t emitted_len = binary_output ? EmitRecord(original_number, line_pairs, count, &emitted)
+                                       : EmitText(original_number, line_pairs, count, &emitted);
+    if (emitted_len > 0) {
+        if (cacheable) {
+            CacheStore(hash, key, key_len, emitted, emitted_len);
+        }
+        CommitOutput(emitted_len);
+    }
+}
+
+// Обрабатывает все полные строки в [current, end) и возвращает начало незавершённого хвоста.
+const char *ProcessLines(const char *current, const char *end) {
+    const char *newline;
+
+    while ((newline = memchr(current, '\n', end - current)) != NULL) {
+        ProcessLine(current, newline);
+        current = newline + 1;
+    }
+    return current;
+}
+
+// Разбор прямо из page cache: файл отображается целиком, строки не копируются и не режутся на куски.
+void ProcessMapped(int file, off_t range_start, off_t range_end) {
+    off_t page_size = sysconf(_SC_PAGESIZE);
+    off_t map_start = range_start - range_start % page_size;
+    size_t map_len = range_end - map_start;
+
+    if (range_end == range_start) {
+        return;
+    }
+
+    char *data = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, file, map_start);
+    if (data == MAP_FAILED) {
+        HandleError("Ошибка отображения файла в память.\n");
+    }
+    madvise(data, map_len, MADV_SEQUENTIAL);
+
+    const char *begin = data + (range_start - map_start);
+    const char *end = data + map_len;
+    const char *tail = ProcessLines(begin, end);
+    if (tail < end) {
+        ProcessLine(tail, end);
+    }
+
+    munmap(data, map_len);
+}
+
+// Потоковый разбор для pipe и других файлов, которые нельзя отобразить.
+void ProcessStream(int file, off_t range_start, off_t range_end) {
+    if (range_start > 0 && lseek(file, range_start, SEEK_SET) == -1) {
+        HandleError("Ошибка позиционирования в файле.\n");
     }
-    close(file);
 
-    char buffer[BUFFER_SIZE];
-    ssize_t bytesRead;
-    char *current;
-    char output[BUFFER_SIZE];
-    int output_len;
+    // Незавершённая строка в конце прочитанного куска переносится в начало буфера
+    // и дочитывается следующим read(), поэтому границы кусков не разрывают строки.
+    size_t capacity = READ_CHUNK_SIZE;
+    size_t filled = 0;
+    char *buffer = malloc(capacity);
+    if (buffer == NULL) {
+        HandleError("Ошибка выделения памяти для буфера чтения.\n");
+    }
+
+    off_t remaining = range_end - range_start;
+    ssize_t bytesRead = 0;
+    while (range_end == -1 || remaining > 0) {
+        size_t to_read = capacity - filled;
+        if (range_end != -1 && (off_t)to_read > remaining) {
+            to_read = remaining;
+        }
+        if ((bytesRead = read(file, buffer + filled, to_read)) <= 0) {
+            break;
+        }
+        remaining -= bytesRead;
+
+        const char *end = buffer + filled + bytesRead;
+        const char *current = ProcessLines(buffer, end);
 
-    while ((bytesRead = read(STDIN_FILENO, buffer, BUFFER_SIZE)) > 0) {
-        current = buffer;
+        filled = end - current;
+        memmove(buffer, current, filled);
 
-        while (current < buffer + bytesRead) {
-            while (*current == ' ' || *current == '\t') {
-                current++;
+        if (filled == capacity) {
+            capacity *= 2;
+            buffer = realloc(buffer, capacity);
+            if (buffer == NULL) {
+                HandleError("Ошибка выделения памяти для буфера чтения.\n");
             }
-            if (*current == '\n') {
-                current++;
-                continue;
+        }
+    }
+
+    if (bytesRead == -1) {
+        HandleError("Ошибка чтения файла.\n");
+    }
+
+    if (filled > 0) {
+        ProcessLine(buffer, buffer + filled);
+    }
+
+    free(buffer);
+}
+
+// Режим -u: чтение и запись через io_uring. Несколько чтений входа и записей результата находятся
+// в полёте одновременно (зарегистрированные буферы, READ_FIXED/WRITE_FIXED), а разбор идёт по уже
+// прочитанным буферам. Если io_uring недоступен, используется обычный потоковый разбор.
+enum {
+    URING_OP_READ = 1,
+    URING_OP_STDOUT = 2,
+    URING_OP_FILE = 3
+};
+
+typedef struct {
+    off_t offset;
+    size_t requested;
+    size_t filled;
+    int active;
+    int done;
+} UringRead;
+
+typedef struct {
+    size_t len;
+    size_t stdout_done;
+    size_t file_done;
+    off_t file_offset;
+    int pending;
+} UringWrite;
+
+Uring ring;
+int uring_input_fd;
+char *uring_read_data[URING_READ_BUFFERS];
+UringRead uring_reads[URING_READ_BUFFERS];
+char *uring_write_data[URING_WRITE_BUFFERS];
+UringWrite uring_writes[URING_WRITE_BUFFERS];
+int uring_current_write;
+off_t uring_file_offset;
+
+// Запись в stdout (pipe) идёт строго по одной, чтобы не нарушить порядок строк;
+// записи в output.txt идут по явным смещениям и могут выполняться параллельно.
+int stdout_queue[URING_WRITE_BUFFERS];
+int stdout_queue_head;
+int stdout_queue_len;
+int stdout_in_flight;
+
+struct io_uring_sqe *UringSqe(void) {
+    struct io_uring_sqe *sqe = UringGetSqe(&ring);
+    if (sqe == NULL) {
+        if (UringEnter(&ring, 0) == -1 || (sqe = UringGetSqe(&ring)) == NULL) {
+            HandleError("Ошибка отправки запроса io_uring.\n");
+        }
+    }
+    return sqe;
+}
+
+void UringQueueRead(int index) {
+    UringRead *read = &uring_reads[index];
+    struct io_uring_sqe *sqe = UringSqe();
+
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->fd = uring_input_fd;
+    sqe->addr = (unsigned long)(uring_read_data[index] + read->filled);
+    sqe->len = read->requested - read->filled;
+    sqe->off = read->offset + read->filled;
+    sqe->buf_index = index;
+    sqe->user_data = ((unsigned long long)URING_OP_READ << 32) | index;
+}
+
+void UringQueueStdoutWrite(int index) {
+    UringWrite *write_op = &uring_writes[index];
+    struct io_uring_sqe *sqe = UringSqe();
+
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->fd = STDOUT_FILENO;
+    sqe->addr = (unsigned long)(uring_write_data[index] + write_op->stdout_done);
+    sqe->len = write_op->len - write_op->stdout_done;
+    sqe->off = (unsigned long long)-1;
+    sqe->buf_index = URING_READ_BUFFERS + index;
+    sqe->user_data = ((unsigned long long)URING_OP_STDOUT << 32) | index;
+    stdout_in_flight = 1;
+}
+
+void UringQueueFileWrite(int index) {
+    UringWrite *write_op = &uring_writes[index];
+    struct io_uring_sqe *sqe = UringSqe();
+
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->fd = output_fd;
+    sqe->addr = (unsigned long)(uring_write_data[index] + write_op->file_done);
+    sqe->len = write_op->len - write_op->file_done;
+    sqe->off = write_op->file_offset + write_op->file_done;
+    sqe->buf_index = URING_READ_BUFFERS + index;
+    sqe->user_data = ((unsigned long long)URING_OP_FILE << 32) | index;
+}
+
+void UringHandleCompletion(const struct io_uring_cqe *cqe) {
+    int kind = cqe->user_data >> 32;
+    int index = cqe->user_data & 0xffffffff;
+
+    if (kind == URING_OP_READ) {
+        UringRead *read = &uring_reads[index];
+        if (cqe->res < 0) {
+            HandleError("Ошибка чтения файла.\n");
+        }
+        read->filled += cqe->res;
+        // Короткое чтение до конца диапазона дочитывается в тот же буфер; 0 -- файл укоротился.
+        if (cqe->res > 0 && read->filled < read->requested) {
+            UringQueueRead(index);
+        } else {
+            read->done = 1;
+        }
+        return;
+    }
+
+    UringWrite *write_op = &uring_writes[index];
+    if (cqe->res < 0) {
+        HandleError("Ошибка записи результата.\n");
+    }
+
+    if (kind == URING_OP_STDOUT) {
+        write_op->stdout_done += cqe->res;
+        if (write_op->stdout_done < write_op->len) {
+            UringQueueStdoutWrite(index);
+            return;
+        }
+        write_op->pending--;
+        stdout_in_flight = 0;
+        if (stdout_queue_len > 0) {
+            int next = stdout_queue[stdout_queue_head];
+            stdout_queue_head = (stdout_queue_head + 1) % URING_WRITE_BUFFERS;
+            stdout_queue_len--;
+            UringQueueStdoutWrite(next);
+        }
+    } else {
+        write_op->file_done += cqe->res;
+        if (write_op->file_done < write_op->len) {
+            UringQueueFileWrite(index);
+            return;
+        }
+        write_op->pending--;
+    }
+}
+
+void UringWaitOne(void) {
+    struct io_uring_cqe cqe;
+
+    if (UringEnter(&ring, 1) == -1) {
+        HandleError("Ошибка ожидания io_uring.\n");
+    }
+    while (UringPopCqe(&ring, &cqe)) {
+        UringHandleCompletion(&cqe);
+    }
+}
+
+// Отдаёт текущий буфер вывода на запись и переключает OutputBatch на следующий свободный.
+void UringFlushOutput(void) {
+    int index = uring_current_write;
+    UringWrite *write_op = &uring_writes[index];
+
+    write_op->len = output_batch.blocks[0].iov_len;
+    write_op->stdout_done = 0;
+    write_op->file_done = 0;
+    write_op->pending = 1;
+
+    if (stdout_in_flight) {
+        stdout_queue[(stdout_queue_head + stdout_queue_len) % URING_WRITE_BUFFERS] = index;
+        stdout_queue_len++;
+    } else {
+        UringQueueStdoutWrite(index);
+    }
+
+    if (output_fd != -1) {
+        write_op->file_offset = uring_file_offset;
+        uring_file_offset += write_op->len;
+        write_op->pending++;
+        UringQueueFileWrite(index);
+    }
+
+    if (UringEnter(&ring, 0) == -1) {
+        HandleError("Ошибка отправки запроса io_uring.\n");
+    }
+
+    uring_current_write = (index + 1) % URING_WRITE_BUFFERS;
+    while (uring_writes[uring_current_write].pending > 0) {
+        UringWaitOne();
+    }
+    output_batch.blocks[0].iov_base = uring_write_data[uring_current_write];
+    output_batch.blocks[0].iov_len = 0;
+    output_batch.pending = 0;
+}
+
+void UringDrainWrites(void) {
+    for (int i = 0; i < URING_WRITE_BUFFERS; i++) {
+        while (uring_writes[i].pending > 0) {
+            UringWaitOne();
+        }
+    }
+}
+
+// Создаёт кольцо и регистрирует буферы. При любой неудаче возвращает 0 и ничего не меняет.
+int UringStart(int file) {
+    struct iovec buffers[URING_READ_BUFFERS + URING_WRITE_BUFFERS];
+    size_t write_size = output_batch.watermark + OUTPUT_BLOCK_SIZE;
+
+    if (UringInit(&ring, URING_ENTRIES) == -1) {
+        return 0;
+    }
+
+    for (int i = 0; i < URING_READ_BUFFERS + URING_WRITE_BUFFERS; i++) {
+        int is_read = i < URING_READ_BUFFERS;
+        buffers[i].iov_len = is_read ? READ_CHUNK_SIZE : write_size;
+        buffers[i].iov_base = mmap(NULL, buffers[i].iov_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffers[i].iov_base == MAP_FAILED) {
+            for (int j = 0; j < i; j++) {
+                munmap(buffers[j].iov_base, buffers[j].iov_len);
             }
+            UringExit(&ring);
+            return 0;
+        }
+    }
 
-            char *endptr;
-            int first_number = safe_strtol(current, &endptr);
-            int original_number = first_number;
-            current = endptr;
+    if (UringRegisterBuffers(&ring, buffers, URING_READ_BUFFERS + URING_WRITE_BUFFERS) == -1) {
+        for (int i = 0; i < URING_READ_BUFFERS + URING_WRITE_BUFFERS; i++) {
+            munmap(buffers[i].iov_base, buffers[i].iov_len);
+        }
+        UringExit(&ring);
+        return 0;
+    }
 
-            output_len = snprintf(output, BUFFER_SIZE, "Число: %d", original_number);
+    for (int i = 0; i < URING_READ_BUFFERS; i++) {
+        uring_read_data[i] = buffers[i].iov_base;
+    }
+    for (int i = 0; i < URING_WRITE_BUFFERS; i++) {
+        uring_write_data[i] = buffers[URING_READ_BUFFERS + i].iov_base;
+    }
 
-            while (1) {
-                while (*current == ' ' || *current == '\t') {
-                    current++;
-                }
+    // Вывод переходит на один непрерывный зарегистрированный буфер вместо набора блоков.
+    for (int i = 0; i < output_batch.max_blocks; i++) {
+        free(output_batch.blocks[i].iov_base);
+    }
+    output_batch.blocks[0].iov_base = uring_write_data[0];
+    output_batch.blocks[0].iov_len = 0;
+    output_batch.block_size = write_size;
+    output_batch.max_blocks = 1;
+    output_batch.count = 1;
 
-                if (*current == '\n' || current >= buffer + bytesRead) {
-                    break;
-                }
+    uring_input_fd = file;
+    uring_active = 1;
+    return 1;
+}
 
-                int next_number = safe_strtol(current, &endptr);
-                if (next_number == 0) {
-                    output_len = snprintf(output, BUFFER_SIZE, "Ошибка: деление на ноль.\n");
-                    write(STDOUT_FILENO, output, output_len);
-                    close(output_fd);
-                    exit(EXIT_FAILURE);
-                }
+void ProcessUring(int file, off_t range_start, off_t range_end) {
+    if (!UringStart(file)) {
+        ProcessStream(file, range_start, range_end);
+        return;
+    }
+
+    off_t next_offset = range_start;
+    for (int i = 0; i < URING_READ_BUFFERS && next_offset < range_end; i++) {
+        UringRead *read = &uring_reads[i];
+        read->offset = next_offset;
+        read->requested = range_end - next_offset < READ_CHUNK_SIZE ? range_end - next_offset : READ_CHUNK_SIZE;
+        read->filled = 0;
+        read->active = 1;
+        read->done = 0;
+        next_offset += read->requested;
+        UringQueueRead(i);
+    }
+
+    // Строка, разрезанная границей буферов, собирается в carry.
+    char *carry = NULL;
+    size_t carry_len = 0;
+    size_t carry_capacity = 0;
+
+    for (int index = 0; uring_reads[index].active; index = (index + 1) % URING_READ_BUFFERS) {
+        UringRead *read = &uring_reads[index];
+        while (!read->done) {
+            UringWaitOne();
+        }
+
+        const char *current = uring_read_data[index];
+        const char *end = current + read->filled;
 
-                output_len += snprintf(output + output_len, BUFFER_SIZE - output_len, ", %d / %d = %d", original_number, next_number, original_number / next_number);
+        if (carry_len > 0) {
+            const char *newline = memchr(current, '\n', end - current);
+            const char *piece_end = newline != NULL ? newline : end;
+            size_t piece = piece_end - current;
 
-                current = endptr;
+            if (carry_len + piece > carry_capacity) {
+                carry_capacity = (carry_len + piece) * 2;
+                carry = realloc(carry, carry_capacity);
+                if (carry == NULL) {
+                    HandleError("Ошибка выделения памяти для буфера чтения.\n");
+                }
             }
+            memcpy(carry + carry_len, current, piece);
+            carry_len += piece;
 
-            output[output_len++] = '\n';
+            if (newline != NULL) {
+                ProcessLine(carry, carry + carry_len);
+                carry_len = 0;
+                current = newline + 1;
+            } else {
+                current = end;
+            }
+        }
 
-            write(STDOUT_FILENO, output, output_len);
-            write(output_fd, output, output_len);
+        const char *tail = ProcessLines(current, end);
+        if (tail < end) {
+            size_t piece = end - tail;
+            if (piece > carry_capacity) {
+                carry_capacity = piece * 2;
+                carry = realloc(carry, carry_capacity);
+                if (carry == NULL) {
+                    HandleError("Ошибка выделения памяти для буфера чтения.\n");
+                }
+            }
+            memcpy(carry, tail, piece);
+            carry_len = piece;
+        }
 
-            while (*current != '\n' && current < buffer + bytesRead) {
-                current++;
+        read->active = 0;
+        if (read->filled < read->requested) {
+            // Файл оказался короче ожидаемого: дальше читать нечего.
+            next_offset = range_end;
+        }
+        if (next_offset < range_end) {
+            read->offset = next_offset;
+            read->requested = range_end - next_offset < READ_CHUNK_SIZE ? range_end - next_offset : READ_CHUNK_SIZE;
+            read->filled = 0;
+            read->active = 1;
+            read->done = 0;
+            next_offset += read->requested;
+            UringQueueRead(index);
+            if (UringEnter(&ring, 0) == -1) {
+                HandleError("Ошибка отправки запроса io_uring.\n");
             }
-            if (*current == '\n') {
-                current++;
+        }
+    }
+
+    if (carry_len > 0) {
+        ProcessLine(carry, carry + carry_len);
+    }
+    free(carry);
+}
+
+int main(int argc, char *argv[]) {
+    // -r START-END: обработать только байты [START, END) файла (границы выровнены по строкам),
+    // -n: не создавать output.txt (его пишет родитель),
+    // -w BYTES: сбрасывать накопленный вывод, когда наберётся BYTES байт,
+    // -s: читать через read() даже обычный файл вместо mmap,
+    // -b: выводить двоичные записи из protocol.h вместо текста (output.txt не создаётся),
+    // -u: читать и писать через io_uring (если он недоступен -- обычный read/write),
+    // -c BYTES: кэшировать вывод повторяющихся строк в пределах BYTES байт.
+    off_t range_start = 0;
+    off_t range_end = -1;
+    int write_output_file = 1;
+    size_t watermark = DEFAULT_FLUSH_WATERMARK;
+    int force_stream = 0;
+    int use_uring = 0;
+    size_t cache_budget = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:nw:sbuc:")) != -1) {
+        switch (opt) {
+            case 'r': {
+                char *endptr;
+                range_start = strtoll(optarg, &endptr, 10);
+                if (*endptr != '-') {
+                    HandleError("Ошибка: диапазон задаётся как НАЧАЛО-КОНЕЦ.\n");
+                }
+                range_end = strtoll(endptr + 1, NULL, 10);
+                if (range_start < 0 || range_end < range_start) {
+                    HandleError("Ошибка: некорректный диапазон.\n");
+                }
+                break;
             }
+            case 'n':
+                write_output_file = 0;
+                break;
+            case 'w':
+                watermark = strtoul(optarg, NULL, 10);
+                if (watermark == 0) {
+                    HandleError("Ошибка: порог сброса вывода должен быть положительным.\n");
+                }
+                break;
+            case 's':
+                force_stream = 1;
+                break;
+            case 'b':
+                binary_output = 1;
+                write_output_file = 0;
+                break;
+            case 'u':
+                use_uring = 1;
+                break;
+            case 'c':
+                cache_budget = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                HandleError("Использование: ./child [-r НАЧАЛО-КОНЕЦ] [-n] [-w БАЙТ] [-s] [-b] [-u] [-c БАЙТ] <файл>\n");
         }
     }
 
-    if (bytesRead == -1) {
-        HandleError("Ошибка чтения файла.\n");
+    if (optind >= argc) {
+        HandleError("Ошибка: необходимо указать путь к файлу.\n");
+    }
+
+    const char *path = argv[optind];
+    int file = open(path, O_RDONLY);
+    if (file == -1) {
+        char error_msg[BUFFER_SIZE];
+        snprintf(error_msg, sizeof(error_msg), "Ошибка открытия файла '%s': %s\n", path, strerror(errno));
+        HandleError(error_msg);
     }
 
-    close(output_fd);
+    if (write_output_file) {
+        output_fd = open("output.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (output_fd == -1) {
+            HandleError("Ошибка создания файла output.txt.\n");
+        }
+    }
+
+    if (dup2(file, STDIN_FILENO) == -1) {
+        HandleError("Ошибка перенаправления ввода.\n");
+    }
+    close(file);
+
+    InitOutput(watermark);
+    if (cache_budget > 0) {
+        InitCache(cache_budget);
+    }
+
+    struct stat st;
+    if ((!force_stream || use_uring) && fstat(STDIN_FILENO, &st) == 0 && S_ISREG(st.st_mode)) {
+        if (range_end == -1 || range_end > st.st_size) {
+            range_end = st.st_size;
+        }
+        if (range_start > range_end) {
+            range_start = range_end;
+        }
+        if (use_uring) {
+            ProcessUring(STDIN_FILENO, range_start, range_end);
+        } else {
+            ProcessMapped(STDIN_FILENO, range_start, range_end);
+        }
+    } else {
+        ProcessStream(STDIN_FILENO, range_start, range_end);
+    }
+    FinishOutput();
+
+    if (output_fd != -1) {
+        close(output_fd);
+    }
     exit(EXIT_SUCCESS);
 }
@@ -1,11 +1,40 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <signal.h>
 #include <string.h>
+#include <errno.h>
 #include <stdio.h>
+#include <limits.h>
+#include "protocol.h"
 
 #define BUFFER_SIZE 1024
+#define RELAY_CHUNK_SIZE (64 * 1024)
+#define SHARD_BUFFER_LIMIT (64 * 1024 * 1024)
+#define ZERO_COPY_PIPE_SIZE (1024 * 1024)
+#define RECORD_BUFFER_SIZE (1024 * 1024)
+#define TEXT_FLUSH_WATERMARK (256 * 1024)
+
+typedef struct {
+    off_t start;
+    off_t end;
+    pid_t pid;
+    int fd;
+    int done;
+    int paused;
+    char *data;
+    size_t len;
+    size_t capacity;
+    size_t stdout_done;
+    size_t file_done;
+} Shard;
+
+int child_uring = 0;
+const char *child_cache_budget = NULL;
 
 void error_handler(const char *msg) {
     write(STDERR_FILENO, msg, strlen(msg));
@@ -13,22 +42,578 @@ void error_handler(const char *msg) {
     exit(EXIT_FAILURE);
 }
 
-int main() {
+// Запускает ./child с флагом режима (может быть NULL), диапазоном (может быть NULL), а также с -u и -c,
+// если они заданы для parent.
+void ExecChild(const char *mode_flag, const char *range, const char *filename) {
+    char *args[10];
+    int count = 0;
+
+    args[count++] = "child";
+    if (mode_flag != NULL) {
+        args[count++] = (char *)mode_flag;
+    }
+    if (range != NULL) {
+        args[count++] = "-r";
+        args[count++] = (char *)range;
+    }
+    if (child_uring) {
+        args[count++] = "-u";
+    }
+    if (child_cache_budget != NULL) {
+        args[count++] = "-c";
+        args[count++] = (char *)child_cache_budget;
+    }
+    args[count++] = (char *)filename;
+    args[count] = NULL;
+
+    execv("./child", args);
+    error_handler("Ошибка выполнения дочернего процесса");
+}
+
+void WriteAll(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(fd, data, len);
+        if (written == -1) {
+            error_handler("Ошибка записи результата");
+        }
+        data += written;
+        len -= written;
+    }
+}
+
+// Сдвигает границу вперёд до начала следующей строки.
+off_t AlignToLine(int fd, off_t offset, off_t size) {
+    char buffer[BUFFER_SIZE];
+
+    if (offset == 0 || offset >= size) {
+        return offset >= size ? size : 0;
+    }
+
+    offset--;
+    while (offset < size) {
+        ssize_t bytesRead = pread(fd, buffer, sizeof(buffer), offset);
+        if (bytesRead <= 0) {
+            error_handler("Ошибка чтения входного файла");
+        }
+        char *newline = memchr(buffer, '\n', bytesRead);
+        if (newline != NULL) {
+            return offset + (newline - buffer) + 1;
+        }
+        offset += bytesRead;
+    }
+    return size;
+}
+
+void StartShardChild(Shard *shard, const char *filename) {
+    int pipe_fd[2];
+    char range[64];
+
+    if (pipe(pipe_fd) == -1) {
+        error_handler("Ошибка создания pipe");
+    }
+
+    snprintf(range, sizeof(range), "%lld-%lld", (long long)shard->start, (long long)shard->end);
+
+    shard->pid = fork();
+    if (shard->pid == -1) {
+        error_handler("Ошибка создания процесса");
+    }
+
+    if (shard->pid == 0) {
+        close(pipe_fd[0]);
+        if (dup2(pipe_fd[1], STDOUT_FILENO) == -1) {
+            error_handler("Ошибка перенаправления вывода");
+        }
+        close(pipe_fd[1]);
+
+        ExecChild("-n", range, filename);
+    }
+
+    close(pipe_fd[1]);
+    shard->fd = pipe_fd[0];
+}
+
+// Выводит накопленное для текущего шарда. Пока child работает, последняя строка придерживается
+// для output.txt: если child завершится с ошибкой, это сообщение об ошибке и в файл оно не попадает.
+void FlushShard(Shard *shard, int output_fd, int failed) {
+    WriteAll(STDOUT_FILENO, shard->data + shard->stdout_done, shard->len - shard->stdout_done);
+    shard->stdout_done = shard->len;
+
+    size_t complete = shard->len;
+    if (!shard->done || failed) {
+        size_t last_line = complete;
+        if (last_line > shard->file_done) {
+            last_line--;
+        }
+        while (last_line > shard->file_done && shard->data[last_line - 1] != '\n') {
+            last_line--;
+        }
+        if (!shard->done || strncmp(shard->data + last_line, "Ошибка", strlen("Ошибка")) == 0) {
+            complete = last_line;
+        }
+    }
+    WriteAll(output_fd, shard->data + shard->file_done, complete - shard->file_done);
+    shard->file_done = complete;
+
+    memmove(shard->data, shard->data + shard->file_done, shard->len - shard->file_done);
+    shard->len -= shard->file_done;
+    shard->stdout_done -= shard->file_done;
+    shard->file_done = 0;
+}
+
+int ReadShard(Shard *shard) {
+    if (shard->capacity - shard->len < RELAY_CHUNK_SIZE) {
+        shard->capacity = shard->capacity ? shard->capacity * 2 : 4 * RELAY_CHUNK_SIZE;
+        shard->data = realloc(shard->data, shard->capacity);
+        if (shard->data == NULL) {
+            error_handler("Ошибка выделения памяти для вывода шарда");
+        }
+    }
+
+    ssize_t readBytes = read(shard->fd, shard->data + shard->len, RELAY_CHUNK_SIZE);
+    if (readBytes == -1) {
+        error_handler("Ошибка чтения из pipe");
+    }
+    shard->len += readBytes;
+    return readBytes > 0;
+}
+
+// Режим -j N: файл делится на N диапазонов по границам строк, каждый обрабатывает свой child,
+// выводы собираются через epoll и печатаются в исходном порядке строк.
+void RunParallel(const char *filename, int jobs) {
+    int input_fd = open(filename, O_RDONLY);
+    if (input_fd == -1) {
+        error_handler("Ошибка открытия входного файла");
+    }
+
+    struct stat st;
+    if (fstat(input_fd, &st) == -1) {
+        error_handler("Ошибка получения размера файла");
+    }
+
+    Shard *shards = calloc(jobs, sizeof(Shard));
+    if (shards == NULL) {
+        error_handler("Ошибка выделения памяти для шардов");
+    }
+
+    for (int i = 0; i < jobs; i++) {
+        shards[i].start = (i == 0) ? 0 : shards[i - 1].end;
+        shards[i].end = AlignToLine(input_fd, st.st_size / jobs * (i + 1), st.st_size);
+        if (i == jobs - 1 || shards[i].end < shards[i].start) {
+            shards[i].end = (i == jobs - 1) ? st.st_size : shards[i].start;
+        }
+    }
+    close(input_fd);
+
+    int output_fd = open("output.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output_fd == -1) {
+        error_handler("Ошибка создания файла output.txt");
+    }
+
+    int epoll_fd = epoll_create1(0);
+    if (epoll_fd == -1) {
+        error_handler("Ошибка создания epoll");
+    }
+
+    printf("[INFO] Запускаем %d дочерних процессов...\n", jobs);
+    fflush(stdout);
+
+    for (int i = 0; i < jobs; i++) {
+        StartShardChild(&shards[i], filename);
+
+        struct epoll_event event = {.events = EPOLLIN, .data.u32 = i};
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, shards[i].fd, &event) == -1) {
+            error_handler("Ошибка регистрации pipe в epoll");
+        }
+    }
+
+    int current = 0;
+    int failed = 0;
+    struct epoll_event events[64];
+
+    while (current < jobs && !failed) {
+        int ready = epoll_wait(epoll_fd, events, 64, -1);
+        if (ready == -1) {
+            error_handler("Ошибка ожидания epoll");
+        }
+
+        for (int e = 0; e < ready; e++) {
+            Shard *shard = &shards[events[e].data.u32];
+            if (!ReadShard(shard)) {
+                shard->done = 1;
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, shard->fd, NULL);
+                close(shard->fd);
+            } else if (shard != &shards[current] && shard->len >= SHARD_BUFFER_LIMIT) {
+                // Буфер ожидающего шарда переполнен: перестаём читать, child встанет на записи в pipe.
+                shard->paused = 1;
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, shard->fd, NULL);
+            }
+        }
+
+        while (current < jobs) {
+            Shard *shard = &shards[current];
+            if (shard->paused) {
+                struct epoll_event event = {.events = EPOLLIN, .data.u32 = current};
+                epoll_ctl(epoll_fd, EPOLL_CTL_ADD, shard->fd, &event);
+                shard->paused = 0;
+            }
+
+            if (!shard->done) {
+                FlushShard(shard, output_fd, 0);
+                break;
+            }
+
+            int status;
+            if (waitpid(shard->pid, &status, 0) == -1) {
+                error_handler("Ошибка ожидания дочернего процесса");
+            }
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                FlushShard(shard, output_fd, 1);
+                failed = 1;
+                break;
+            }
+            FlushShard(shard, output_fd, 0);
+            free(shard->data);
+            current++;
+        }
+    }
+
+    if (failed) {
+        for (int i = current + 1; i < jobs; i++) {
+            kill(shards[i].pid, SIGTERM);
+            waitpid(shards[i].pid, NULL, 0);
+        }
+    }
+
+    close(epoll_fd);
+    close(output_fd);
+    free(shards);
+    printf("[INFO] Родительский процесс: завершено ожидание дочерних процессов.\n");
+    exit(EXIT_SUCCESS);
+}
+
+// Переносит ровно len байт из pipe в fd через splice, без копирования в user space.
+void SpliceAll(int pipe_fd, int fd, size_t len) {
+    while (len > 0) {
+        ssize_t moved = splice(pipe_fd, NULL, fd, NULL, len, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (moved <= 0) {
+            error_handler("Ошибка splice");
+        }
+        len -= moved;
+    }
+}
+
+// Переносит ровно len байт из pipe в fd через обычные read/write (консоль не поддерживает splice).
+void CopyAll(int pipe_fd, int fd, size_t len) {
+    char buffer[RELAY_CHUNK_SIZE];
+
+    while (len > 0) {
+        ssize_t readBytes = read(pipe_fd, buffer, len < sizeof(buffer) ? len : sizeof(buffer));
+        if (readBytes <= 0) {
+            error_handler("Ошибка чтения из pipe");
+        }
+        WriteAll(fd, buffer, readBytes);
+        len -= readBytes;
+    }
+}
+
+// Режим -z: tee дублирует содержимое pipe от child во второй pipe, откуда оно уходит в output.txt,
+// а сам вывод child пересылается в stdout через splice. Данные не проходят через user space.
+void RelayZeroCopy(int pipe_fd, pid_t child_pid) {
+    int tee_pipe[2];
+    if (pipe(tee_pipe) == -1) {
+        error_handler("Ошибка создания pipe");
+    }
+
+    // Большие pipe сокращают число системных вызовов на мегабайт; при отказе остаётся размер по умолчанию.
+    fcntl(pipe_fd, F_SETPIPE_SZ, ZERO_COPY_PIPE_SIZE);
+    fcntl(tee_pipe[1], F_SETPIPE_SZ, ZERO_COPY_PIPE_SIZE);
+
+    int output_fd = open("output.txt", O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (output_fd == -1) {
+        error_handler("Ошибка создания файла output.txt");
+    }
+
+    int stdout_splice = 1;
+    off_t file_size = 0;
+    ssize_t teed;
+
+    while ((teed = tee(pipe_fd, tee_pipe[1], ZERO_COPY_PIPE_SIZE, 0)) > 0) {
+        SpliceAll(tee_pipe[0], output_fd, teed);
+        file_size += teed;
+
+        if (stdout_splice) {
+            ssize_t moved = splice(pipe_fd, NULL, STDOUT_FILENO, NULL, teed, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (moved == -1 && errno == EINVAL) {
+                stdout_splice = 0;
+                moved = 0;
+            } else if (moved <= 0) {
+                error_handler("Ошибка splice");
+            }
+            teed -= moved;
+        }
+        if (stdout_splice) {
+            SpliceAll(pipe_fd, STDOUT_FILENO, teed);
+        } else {
+            CopyAll(pipe_fd, STDOUT_FILENO, teed);
+        }
+    }
+    if (teed == -1) {
+        error_handler("Ошибка tee");
+    }
+
+    int status;
+    if (waitpid(child_pid, &status, 0) == -1) {
+        error_handler("Ошибка ожидания дочернего процесса");
+    }
+
+    // Сообщение об ошибке child пишет только в консоль, поэтому из output.txt его нужно убрать.
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        char tail[BUFFER_SIZE];
+        off_t tail_start = file_size > (off_t)sizeof(tail) ? file_size - (off_t)sizeof(tail) : 0;
+        ssize_t tail_len = pread(output_fd, tail, file_size - tail_start, tail_start);
+        if (tail_len > 0) {
+            ssize_t last_line = tail_len - 1;
+            while (last_line > 0 && tail[last_line - 1] != '\n') {
+                last_line--;
+            }
+            if (strncmp(tail + last_line, "Ошибка", strlen("Ошибка")) == 0) {
+                ftruncate(output_fd, tail_start + last_line);
+            }
+        }
+    }
+
+    close(tee_pipe[0]);
+    close(tee_pipe[1]);
+    close(output_fd);
+}
+
+typedef struct {
+    long long lines;
+    long long divisions;
+    long long quotient_sum;
+    int quotient_min;
+    int quotient_max;
+    long long division_errors;
+} Aggregates;
+
+typedef struct {
+    char *data;
+    size_t len;
+    int output_fd;
+} TextOutput;
+
+void FlushText(TextOutput *text) {
+    WriteAll(STDOUT_FILENO, text->data, text->len);
+    WriteAll(text->output_fd, text->data, text->len);
+    text->len = 0;
+}
+
+// Текст строится только здесь, на выходе: формат совпадает с текстовым режимом child.
+void RenderRecord(TextOutput *text, const RecordHeader *header, const RecordPair *pairs) {
+    if (text->len > TEXT_FLUSH_WATERMARK) {
+        FlushText(text);
+    }
+
+    char *output = text->data + text->len;
+    int output_len = snprintf(output, BUFFER_SIZE, "Число: %d", header->dividend);
+    for (uint32_t i = 0; i < header->count && output_len < BUFFER_SIZE - 1; i++) {
+        output_len += snprintf(output + output_len, BUFFER_SIZE - output_len, ", %d / %d = %d", header->dividend, pairs[i].divisor, pairs[i].quotient);
+    }
+    if (output_len > BUFFER_SIZE - 2) {
+        output_len = BUFFER_SIZE - 2;
+    }
+    output[output_len++] = '\n';
+    text->len += output_len;
+}
+
+void AggregateRecord(Aggregates *stats, const RecordHeader *header, const RecordPair *pairs) {
+    stats->lines++;
+    for (uint32_t i = 0; i < header->count; i++) {
+        int quotient = pairs[i].quotient;
+        stats->divisions++;
+        stats->quotient_sum += quotient;
+        if (quotient < stats->quotient_min) {
+            stats->quotient_min = quotient;
+        }
+        if (quotient > stats->quotient_max) {
+            stats->quotient_max = quotient;
+        }
+    }
+}
+
+// Режимы -b и -a: child передаёт двоичные записи из protocol.h. В режиме -b parent превращает их
+// в текст (stdout и output.txt), в режиме -a только считает агрегаты без какого-либо форматирования.
+void RelayBinary(int pipe_fd, pid_t child_pid, int aggregate) {
+    size_t capacity = RECORD_BUFFER_SIZE;
+    size_t filled = 0;
+    char *buffer = malloc(capacity);
+    if (buffer == NULL) {
+        error_handler("Ошибка выделения памяти для записей");
+    }
+
+    TextOutput text = {NULL, 0, -1};
+    if (!aggregate) {
+        text.data = malloc(TEXT_FLUSH_WATERMARK + BUFFER_SIZE);
+        if (text.data == NULL) {
+            error_handler("Ошибка выделения памяти для вывода");
+        }
+        text.output_fd = open("output.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (text.output_fd == -1) {
+            error_handler("Ошибка создания файла output.txt");
+        }
+    }
+
+    Aggregates stats = {0, 0, 0, INT_MAX, INT_MIN, 0};
+    RecordPair *pairs = NULL;
+    size_t pairs_capacity = 0;
+    ssize_t readBytes;
+
+    while ((readBytes = read(pipe_fd, buffer + filled, capacity - filled)) > 0) {
+        filled += readBytes;
+
+        size_t offset = 0;
+        while (filled - offset >= sizeof(RecordHeader)) {
+            RecordHeader header;
+            memcpy(&header, buffer + offset, sizeof(header));
+            if (header.length != sizeof(RecordHeader) + (size_t)header.count * sizeof(RecordPair)) {
+                error_handler("Ошибка: повреждённая запись от дочернего процесса");
+            }
+            if (filled - offset < header.length) {
+                break;
+            }
+
+            // Пары читаются из копии, чтобы не зависеть от выравнивания внутри буфера.
+            if (header.count > pairs_capacity) {
+                pairs_capacity = header.count;
+                pairs = realloc(pairs, pairs_capacity * sizeof(RecordPair));
+                if (pairs == NULL) {
+                    error_handler("Ошибка выделения памяти для записи");
+                }
+            }
+            memcpy(pairs, buffer + offset + sizeof(header), header.count * sizeof(RecordPair));
+
+            if (header.type == RECORD_DIVISION_BY_ZERO) {
+                stats.division_errors++;
+                if (!aggregate) {
+                    const char *message = "Ошибка: деление на ноль.\n";
+                    FlushText(&text);
+                    WriteAll(STDOUT_FILENO, message, strlen(message));
+                }
+            } else if (aggregate) {
+                AggregateRecord(&stats, &header, pairs);
+            } else {
+                RenderRecord(&text, &header, pairs);
+            }
+
+            offset += header.length;
+        }
+
+        memmove(buffer, buffer + offset, filled - offset);
+        filled -= offset;
+
+        if (filled == capacity) {
+            capacity *= 2;
+            buffer = realloc(buffer, capacity);
+            if (buffer == NULL) {
+                error_handler("Ошибка выделения памяти для записей");
+            }
+        }
+    }
+    if (readBytes == -1) {
+        error_handler("Ошибка чтения из pipe");
+    }
+    if (filled != 0) {
+        error_handler("Ошибка: неполная запись от дочернего процесса");
+    }
+
+    waitpid(child_pid, NULL, 0);
+
+    if (aggregate) {
+        char summary[BUFFER_SIZE];
+        int summary_len = snprintf(summary, sizeof(summary),
+                                   "Строк: %lld\nДелений: %lld\nСумма частных: %lld\n"
+                                   "Минимальное частное: %d\nМаксимальное частное: %d\nОшибок деления на ноль: %lld\n",
+                                   stats.lines, stats.divisions, stats.quotient_sum,
+                                   stats.divisions ? stats.quotient_min : 0, stats.divisions ? stats.quotient_max : 0,
+                                   stats.division_errors);
+        WriteAll(STDOUT_FILENO, summary, summary_len);
+    } else {
+        FlushText(&text);
+        close(text.output_fd);
+        free(text.data);
+    }
+    free(pairs);
+    free(buffer);
+}
+
+int main(int argc, char *argv[]) {
     int pipe1[2];
     pid_t child_pid;
     char filename[BUFFER_SIZE];
     ssize_t bytesRead;
+    int jobs = 0;
+    int zero_copy = 0;
+    int binary = 0;
+    int aggregate = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:zbauc:")) != -1) {
+        switch (opt) {
+            case 'j':
+                jobs = atoi(optarg);
+                if (jobs <= 0) {
+                    error_handler("Ошибка: число процессов должно быть положительным");
+                }
+                break;
+            case 'z':
+                zero_copy = 1;
+                break;
+            case 'b':
+                binary = 1;
+                break;
+            case 'a':
+                binary = 1;
+                aggregate = 1;
+                break;
+            case 'u':
+                child_uring = 1;
+                break;
+            case 'c':
+                child_cache_budget = optarg;
+                break;
+            default:
+                error_handler("Использование: ./parent [-j N | -z | -b | -a] [-u] [-c БАЙТ] [файл]");
+        }
+    }
 
-    const char *prompt = "Введите имя файла: ";
-    write(STDOUT_FILENO, prompt, strlen(prompt));
+    if ((jobs > 0) + zero_copy + binary > 1) {
+        error_handler("Ошибка: режимы -j, -z и -b/-a несовместимы");
+    }
+
+    // Имя файла можно передать аргументом, тогда parent работает без запроса (например, в bench).
+    if (optind < argc) {
+        if (strlen(argv[optind]) >= sizeof(filename)) {
+            error_handler("Ошибка: слишком длинное имя файла");
+        }
+        strcpy(filename, argv[optind]);
+    } else {
+        const char *prompt = "Введите имя файла: ";
+        write(STDOUT_FILENO, prompt, strlen(prompt));
+
+        bytesRead = read(STDIN_FILENO, filename, sizeof(filename) - 1);
+        if (bytesRead <= 0) {
+            error_handler("Ошибка чтения имени файла");
+        }
+        filename[bytesRead] = '\0';
 
-    bytesRead = read(STDIN_FILENO, filename, sizeof(filename));
-    if (bytesRead <= 0) {
-        error_handler("Ошибка чтения имени файла");
+        if (filename[bytesRead - 1] == '\n') {
+            filename[bytesRead - 1] = '\0';
+        }
     }
 
-    if (filename[bytesRead - 1] == '\n') {
-        filename[bytesRead - 1] = '\0';
+    if (jobs > 0) {
+        RunParallel(filename, jobs);
     }
 
     printf("[INFO] Создаем pipe...\n");
@@ -52,11 +637,28 @@ int main() {
         close(pipe1[1]);
 
         printf("[INFO] Дочерний процесс: выполняем child...\n");
-        execl("./child", "child", filename, NULL);
-        error_handler("Ошибка выполнения дочернего процесса");
+        ExecChild(zero_copy ? "-n" : binary ? "-b" : NULL, NULL, filename);
     } else {
         close(pipe1[1]);
 
+        if (zero_copy) {
+            printf("[INFO] Родительский процесс: пересылаем вывод через splice/tee...\n");
+            fflush(stdout);
+            RelayZeroCopy(pipe1[0], child_pid);
+            close(pipe1[0]);
+            printf("[INFO] Родительский процесс: завершено ожидание дочернего процесса.\n");
+            exit(EXIT_SUCCESS);
+        }
+
+        if (binary) {
+            printf("[INFO] Родительский процесс: читаем двоичные записи из pipe...\n");
+            fflush(stdout);
+            RelayBinary(pipe1[0], child_pid, aggregate);
+            close(pipe1[0]);
+            printf("[INFO] Родительский процесс: завершено ожидание дочернего процесса.\n");
+            exit(EXIT_SUCCESS);
+        }
+
         char buffer[BUFFER_SIZE];
         ssize_t readBytes;
         printf("[INFO] Родительский процесс: читаем из pipe...\n");
@@ -0,0 +1,25 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+
+// Двоичный формат записей между child и parent (режим -b).
+// Каждая запись начинается с заголовка, за которым идут count пар (делитель, частное).
+// length -- полная длина записи в байтах вместе с заголовком. Порядок байт -- машинный.
+
+#define RECORD_RESULT 1
+#define RECORD_DIVISION_BY_ZERO 2
+
+typedef struct {
+    uint32_t length;
+    uint32_t type;
+    int32_t dividend;
+    uint32_t count;
+} RecordHeader;
+
+typedef struct {
+    int32_t divisor;
+    int32_t quotient;
+} RecordPair;
+
+#endif
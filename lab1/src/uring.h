@@ -0,0 +1,45 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+// Минимальная обёртка над системными вызовами io_uring (без liburing):
+// отображение колец SQ/CQ, выдача SQE, отправка и разбор завершений.
+
+typedef struct {
+    int fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    unsigned sq_local_tail;
+    unsigned to_submit;
+    void *sq_ring;
+    void *cq_ring;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    size_t sqes_size;
+} Uring;
+
+// Возвращают -1 с errno, если io_uring недоступен; вызывающий код выбирает обычный ввод-вывод.
+int UringInit(Uring *ring, unsigned entries);
+int UringRegisterBuffers(Uring *ring, const struct iovec *buffers, unsigned count);
+void UringExit(Uring *ring);
+
+// NULL, если все SQE заняты и нужно сначала вызвать UringEnter.
+struct io_uring_sqe *UringGetSqe(Uring *ring);
+
+// Отправляет накопленные SQE и ждёт не меньше min_complete завершений.
+int UringEnter(Uring *ring, unsigned min_complete);
+
+// Забирает одно завершение, если оно есть; возвращает 0, если очередь пуста.
+int UringPopCqe(Uring *ring, struct io_uring_cqe *cqe);
+
+#endif
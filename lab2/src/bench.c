@@ -0,0 +1,300 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#define MAX_VARIANTS 8
+#define MAX_POINTS 32
+#define MAX_REPEATS 64
+#define REPORT_FD 3
+#define REPORT_SIZE 256
+#define COUNTERS 3
+
+// Замер вариантов lab2 -- lockfree (базовая линия без синхронизации), mutex и atomic -- на сетке
+// размеров матрицы и числа потоков.
+//   ./bench [-v ВАРИАНТЫ] [-t ПОТОКИ] [-n РАЗМЕРЫ] [-w ПРОГРЕВОВ] [-r ПОВТОРОВ] [-s SEED] [-f csv|json] [-p КАТАЛОГ]
+// Списки задаются через запятую, например -t 1,2,4,8 -n 512,1024. Каждый прогон -- отдельный процесс
+// варианта с одним и тем же seed и результатом в /dev/null. Время и счётчики perf вариант замеряет сам,
+// только на фазе умножения, и пишет их в дескриптор REPORT_FD (measure.h). Переменные окружения GEMM_*
+// передаются вариантам как есть.
+// На каждую точку печатается медиана по повторам: время, GFLOP/s (8 N^3 вещественных операций, как у
+// обычного комплексного умножения), ускорение относительно наименьшего числа потоков того же варианта,
+// отношение ко времени lockfree при тех же размере и потоках и медианы счётчиков. Недоступные значения
+// в CSV -- пустые поля, в JSON -- null.
+
+typedef struct {
+    size_t variant;
+    size_t size;
+    size_t threads;
+    double median;
+    double best;
+    long long counters[COUNTERS];
+} Result;
+
+static const char *counter_names[COUNTERS] = {"cycles", "instructions", "llc_misses"};
+
+void HandleError(const char *message) {
+    write(STDERR_FILENO, message, strlen(message));
+    exit(EXIT_FAILURE);
+}
+
+size_t ParseList(const char *text, size_t *values) {
+    size_t count = 0;
+    const char *current = text;
+
+    while (*current != '\0') {
+        char *end;
+        unsigned long value = strtoul(current, &end, 10);
+        if (end == current || (*end != ',' && *end != '\0') || value == 0 || count == MAX_POINTS) {
+            HandleError("Ошибка: список задаётся положительными числами через запятую (не больше 32).\n");
+        }
+        values[count++] = value;
+        current = *end == ',' ? end + 1 : end;
+    }
+    return count;
+}
+
+size_t ParseVariants(char *text, const char **variants) {
+    size_t count = 0;
+
+    for (char *token = strtok(text, ","); token != NULL; token = strtok(NULL, ",")) {
+        if (count == MAX_VARIANTS) {
+            HandleError("Ошибка: слишком много вариантов.\n");
+        }
+        variants[count++] = token;
+    }
+    return count;
+}
+
+int CompareDoubles(const void *left, const void *right) {
+    double a = *(const double *)left, b = *(const double *)right;
+    return (a > b) - (a < b);
+}
+
+int CompareLongs(const void *left, const void *right) {
+    long long a = *(const long long *)left, b = *(const long long *)right;
+    return (a > b) - (a < b);
+}
+
+// Один прогон варианта; возвращает время фазы умножения и счётчики (-1 -- недоступен).
+double RunVariant(const char *path, size_t threads, size_t size, uint64_t seed, long long *counters) {
+    char threads_text[32], size_text[32], seed_text[32], fd_text[16];
+    snprintf(threads_text, sizeof(threads_text), "%zu", threads);
+    snprintf(size_text, sizeof(size_text), "%zu", size);
+    snprintf(seed_text, sizeof(seed_text), "%llu", (unsigned long long)seed);
+    snprintf(fd_text, sizeof(fd_text), "%d", REPORT_FD);
+    char *args[] = {(char *)path, "-r", fd_text, "-s", seed_text, "-o", "/dev/null", threads_text, size_text, NULL};
+
+    int report[2];
+    if (pipe(report) == -1) {
+        HandleError("Ошибка создания канала.\n");
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        HandleError("Ошибка создания процесса.\n");
+    }
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        close(report[0]);
+        if (null_fd == -1 || dup2(null_fd, STDOUT_FILENO) == -1) {
+            HandleError("Ошибка перенаправления вывода.\n");
+        }
+        if (report[1] != REPORT_FD) {
+            if (dup2(report[1], REPORT_FD) == -1) {
+                HandleError("Ошибка перенаправления отчёта.\n");
+            }
+            close(report[1]);
+        }
+        execv(path, args);
+        HandleError("Ошибка запуска варианта.\n");
+    }
+
+    close(report[1]);
+    char buffer[REPORT_SIZE];
+    size_t length = 0;
+    ssize_t bytes;
+    while (length < sizeof(buffer) - 1 && (bytes = read(report[0], buffer + length, sizeof(buffer) - 1 - length)) > 0) {
+        length += bytes;
+    }
+    buffer[length] = '\0';
+    close(report[0]);
+
+    int status;
+    if (waitpid(pid, &status, 0) == -1) {
+        HandleError("Ошибка ожидания варианта.\n");
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        HandleError("Ошибка: вариант завершился с ошибкой.\n");
+    }
+
+    double seconds;
+    if (sscanf(buffer, "%lf %lld %lld %lld", &seconds, &counters[0], &counters[1], &counters[2]) != 4) {
+        HandleError("Ошибка: вариант не прислал отчёт о замере.\n");
+    }
+    return seconds;
+}
+
+void MeasurePoint(Result *result, const char *path, size_t warmups, size_t repeats, uint64_t seed) {
+    double seconds[MAX_REPEATS];
+    long long counters[COUNTERS][MAX_REPEATS];
+    long long sample[COUNTERS];
+
+    for (size_t run = 0; run < warmups; run++) {
+        RunVariant(path, result->threads, result->size, seed, sample);
+    }
+    for (size_t run = 0; run < repeats; run++) {
+        seconds[run] = RunVariant(path, result->threads, result->size, seed, sample);
+        for (int c = 0; c < COUNTERS; c++) {
+            counters[c][run] = sample[c];
+        }
+    }
+
+    qsort(seconds, repeats, sizeof(double), CompareDoubles);
+    result->median = seconds[repeats / 2];
+    result->best = seconds[0];
+    // Счётчик недоступен хотя бы в одном прогоне -- недоступен и в итоге.
+    for (int c = 0; c < COUNTERS; c++) {
+        qsort(counters[c], repeats, sizeof(long long), CompareLongs);
+        result->counters[c] = counters[c][0] < 0 ? -1 : counters[c][repeats / 2];
+    }
+}
+
+void PrintField(int json, const char *name, double value, int valid, int precision) {
+    if (json) {
+        printf(",\"%s\":", name);
+    } else {
+        printf(",");
+    }
+    if (valid) {
+        printf("%.*f", precision, value);
+    } else if (json) {
+        printf("null");
+    }
+}
+
+void PrintResults(const Result *results, size_t count, const char **variants, int json) {
+    if (!json) {
+        printf("variant,size,threads,median_s,best_s,gflops,speedup,vs_lockfree,cycles,instructions,llc_misses,ipc\n");
+    }
+
+    for (size_t r = 0; r < count; r++) {
+        const Result *result = &results[r];
+        const Result *base = NULL;
+        const Result *lockfree = NULL;
+
+        for (size_t other = 0; other < count; other++) {
+            const Result *candidate = &results[other];
+            if (candidate->size != result->size) {
+                continue;
+            }
+            if (candidate->variant == result->variant && (base == NULL || candidate->threads < base->threads)) {
+                base = candidate;
+            }
+            if (strcmp(variants[candidate->variant], "lockfree") == 0 && candidate->threads == result->threads) {
+                lockfree = candidate;
+            }
+        }
+
+        double flops = 8.0 * result->size * result->size * result->size;
+        const long long *counters = result->counters;
+
+        printf(json ? "{\"variant\":\"%s\"" : "%s", variants[result->variant]);
+        PrintField(json, "size", result->size, 1, 0);
+        PrintField(json, "threads", result->threads, 1, 0);
+        PrintField(json, "median_s", result->median, 1, 6);
+        PrintField(json, "best_s", result->best, 1, 6);
+        PrintField(json, "gflops", flops / result->median / 1e9, result->median > 0, 3);
+        PrintField(json, "speedup", base->median / result->median, result->median > 0, 3);
+        PrintField(json, "vs_lockfree", lockfree ? lockfree->median / result->median : 0,
+                   lockfree != NULL && result->median > 0, 3);
+        for (int c = 0; c < COUNTERS; c++) {
+            PrintField(json, counter_names[c], counters[c], counters[c] >= 0, 0);
+        }
+        PrintField(json, "ipc", counters[1] / (double)counters[0], counters[0] > 0 && counters[1] >= 0, 3);
+        printf(json ? "}\n" : "\n");
+    }
+}
+
+int main(int argc, char **argv) {
+    char default_variants[] = "lockfree,mutex,atomic";
+    const char *variants[MAX_VARIANTS];
+    size_t variant_count = 0;
+    size_t threads[MAX_POINTS];
+    size_t thread_count = 0;
+    size_t sizes[MAX_POINTS] = {256, 512, 1024};
+    size_t size_count = 3;
+    size_t warmups = 1;
+    size_t repeats = 3;
+    uint64_t seed = 1;
+    int json = 0;
+    const char *directory = ".";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "v:t:n:w:r:s:f:p:")) != -1) {
+        switch (opt) {
+            case 'v': variant_count = ParseVariants(optarg, variants); break;
+            case 't': thread_count = ParseList(optarg, threads); break;
+            case 'n': size_count = ParseList(optarg, sizes); break;
+            case 'w': warmups = strtoul(optarg, NULL, 10); break;
+            case 'r': repeats = strtoul(optarg, NULL, 10); break;
+            case 's': seed = strtoull(optarg, NULL, 0); break;
+            case 'f':
+                if (strcmp(optarg, "json") == 0) {
+                    json = 1;
+                } else if (strcmp(optarg, "csv") != 0) {
+                    HandleError("Ошибка: формат -- csv или json.\n");
+                }
+                break;
+            case 'p': directory = optarg; break;
+            default:
+                HandleError("Использование: ./bench [-v ВАРИАНТЫ] [-t ПОТОКИ] [-n РАЗМЕРЫ] [-w ПРОГРЕВОВ] "
+                            "[-r ПОВТОРОВ] [-s SEED] [-f csv|json] [-p КАТАЛОГ]\n");
+        }
+    }
+    if (repeats < 1 || repeats > MAX_REPEATS) {
+        HandleError("Ошибка: число повторов -- от 1 до 64.\n");
+    }
+
+    if (variant_count == 0) {
+        variant_count = ParseVariants(default_variants, variants);
+    }
+    // По умолчанию потоки удваиваются до числа ядер, и само число ядер тоже входит в сетку.
+    if (thread_count == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        for (size_t count = 1; count < (size_t)cores && thread_count < MAX_POINTS - 1; count *= 2) {
+            threads[thread_count++] = count;
+        }
+        threads[thread_count++] = cores > 0 ? (size_t)cores : 1;
+    }
+
+    Result *results = malloc(variant_count * thread_count * size_count * sizeof(Result));
+    if (results == NULL) {
+        HandleError("Ошибка выделения памяти для результатов.\n");
+    }
+
+    size_t count = 0;
+    for (size_t s = 0; s < size_count; s++) {
+        for (size_t v = 0; v < variant_count; v++) {
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/%s", directory, variants[v]);
+
+            for (size_t t = 0; t < thread_count; t++) {
+                Result *result = &results[count++];
+                result->variant = v;
+                result->size = sizes[s];
+                result->threads = threads[t];
+                MeasurePoint(result, path, warmups, repeats, seed);
+                fprintf(stderr, "%s N=%zu потоков %zu: %.6f с\n", variants[v], sizes[s], threads[t], result->median);
+            }
+        }
+    }
+
+    PrintResults(results, count, variants, json);
+    free(results);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,243 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "driver.h"
+#include "generator.h"
+#include "measure.h"
+#include "placement.h"
+#include "storage.h"
+
+#define USAGE_SIZE 2048
+
+// Общий результат; как потоки пишут в него блоки, решает вариант (PublishBlock).
+Matrix result;
+
+typedef struct {
+    size_t worker;
+    TileScheduler *scheduler;
+    Placement *placement;
+    int generate;
+    uint64_t seed;
+    Matrix *matrix1;
+    Matrix *matrix2;
+    PackedMatrix *packed;
+} ThreadArgs;
+
+void HandleError(const char *msg) {
+    write(STDERR_FILENO, msg, strlen(msg));
+    exit(EXIT_FAILURE);
+}
+
+void *MatrixMultiply(void *args) {
+    ThreadArgs *data = (ThreadArgs *)args;
+    GemmWorkspace workspace;
+    size_t first, last;
+
+    // Свои строки матриц и буферы поток размещает сам, на своём узле: входы заполняет (если они не
+    // загружены из файлов), результат обнуляет. После первого барьера готовы обе матрицы, после второго --
+    // вся упакованная matrix2.
+    PinWorker(data->placement, data->worker);
+    WorkerRows(data->scheduler, data->worker, &first, &last);
+    if (data->generate) {
+        FillRandomRows(data->matrix1, data->seed, 0, first, last);
+        FillRandomRows(data->matrix2, data->seed, 1, first, last);
+    }
+    TouchRows(&result, first, last);
+    AllocateWorkspace(&workspace);
+    PlacementWait(data->placement);
+    PackPanels(data->packed, data->matrix2, data->worker, data->scheduler->workers);
+    PlacementWait(data->placement);
+
+    Tile tile;
+    while (NextTile(data->scheduler, data->worker, &tile)) {
+        MultiplyBlock(data->matrix1, data->packed, tile.row, tile.rows, tile.col, tile.cols, &workspace);
+        PublishBlock(&result, &tile, &workspace);
+    }
+
+    FreeWorkspace(&workspace);
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    char usage[USAGE_SIZE];
+    snprintf(usage, sizeof(usage),
+             "Использование: ./%s [-s|--seed число] [-a файл -b файл] [-A файл] [-B файл] [-o файл] "
+             "<количество потоков, 0 -- по числу ядер> [<размер матрицы>]\n"
+             "  -s, --seed -- зерно генератора: при одном зерне матрицы одинаковы при любом числе потоков\n"
+             "               (по умолчанию -- текущее время)\n"
+             "  -a, -b -- загрузить matrix1 и matrix2 из двоичных файлов (размер тогда не указывается)\n"
+             "  -A, -B -- сохранить matrix1 и matrix2 в двоичные файлы\n"
+             "  -o -- записать результат в двоичный файл вместо текста в stdout\n"
+             "  -r -- записать в дескриптор время и счётчики фазы умножения (для bench)\n", VARIANT_NAME);
+    const char *load1 = NULL;
+    const char *load2 = NULL;
+    const char *save1 = NULL;
+    const char *save2 = NULL;
+    const char *output = NULL;
+    int report_fd = -1;
+    uint64_t seed = time(NULL);
+    static const struct option long_options[] = {{"seed", required_argument, NULL, 's'}, {NULL, 0, NULL, 0}};
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "s:a:b:A:B:o:r:", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 's': {
+                char *end;
+                errno = 0;
+                seed = strtoull(optarg, &end, 0);
+                if (errno != 0 || end == optarg || *end != '\0') {
+                    HandleError("Ошибка: зерно должно быть целым числом.\n");
+                }
+                break;
+            }
+            case 'a':
+                load1 = optarg;
+                break;
+            case 'b':
+                load2 = optarg;
+                break;
+            case 'A':
+                save1 = optarg;
+                break;
+            case 'B':
+                save2 = optarg;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'r':
+                report_fd = atoi(optarg);
+                break;
+            default:
+                HandleError(usage);
+        }
+    }
+
+    if ((load1 == NULL) != (load2 == NULL)) {
+        HandleError("Ошибка: -a и -b задаются только вместе.\n");
+    }
+    int generate = load1 == NULL;
+    if (argc - optind != (generate ? 2 : 1)) {
+        HandleError(usage);
+    }
+
+    size_t threads_count = strtoul(argv[optind], NULL, 10);
+    if (threads_count == 0) {
+        threads_count = DefaultWorkerCount();
+    }
+
+    Matrix matrix1, matrix2;
+    size_t matrix_size;
+
+    if (generate) {
+        matrix_size = strtoul(argv[optind + 1], NULL, 10);
+        AllocateMatrix(&matrix1, matrix_size, matrix_size, MATRIX_SPLIT);
+        AllocateMatrix(&matrix2, matrix_size, matrix_size, MATRIX_SPLIT);
+    } else {
+        LoadMatrix(&matrix1, load1);
+        LoadMatrix(&matrix2, load2);
+        if (matrix1.rows != matrix1.cols || matrix2.rows != matrix2.cols || matrix1.rows != matrix2.rows) {
+            HandleError("Ошибка: матрицы должны быть квадратными и одного размера.\n");
+        }
+        matrix_size = matrix1.rows;
+    }
+    AllocateMatrix(&result, matrix_size, matrix_size, MATRIX_SPLIT);
+
+    SelectGemmKernel();
+    SelectGemmMethod();
+
+    // matrix2 упаковывается один раз (каждый поток -- свою долю панелей) и дальше только читается
+    PackedMatrix packed;
+    AllocatePackedMatrix(&packed, &matrix2);
+
+    TileScheduler scheduler;
+    InitScheduler(&scheduler, matrix_size, threads_count);
+
+    Placement placement;
+    InitPlacement(&placement, threads_count);
+
+    Measure measure;
+    InitMeasure(&measure, report_fd != -1);
+    InitPublish();
+
+    pthread_t *threads = malloc(threads_count * sizeof(pthread_t));
+    ThreadArgs *thread_args = malloc(threads_count * sizeof(ThreadArgs));
+    if (threads == NULL || thread_args == NULL) {
+        HandleError("Ошибка выделения памяти для потоков.\n");
+    }
+
+    for (size_t i = 0; i < threads_count; i++) {
+        thread_args[i].worker = i;
+        thread_args[i].scheduler = &scheduler;
+        thread_args[i].placement = &placement;
+        thread_args[i].generate = generate;
+        thread_args[i].seed = seed;
+        thread_args[i].matrix1 = &matrix1;
+        thread_args[i].matrix2 = &matrix2;
+        thread_args[i].packed = &packed;
+
+        if (pthread_create(&threads[i], NULL, MatrixMultiply, &thread_args[i]) != 0) {
+            HandleError("Ошибка создания потока.\n");
+        }
+    }
+
+    // Входы готовы после первого барьера, дальше -- упаковка matrix2 и умножение
+    PlacementWait(&placement);
+    StartMeasure(&measure);
+    PlacementWait(&placement);
+
+    for (size_t i = 0; i < threads_count; i++) {
+        if (pthread_join(threads[i], NULL) != 0) {
+            HandleError("Ошибка ожидания потока.\n");
+        }
+    }
+
+    StopMeasure(&measure);
+    if (report_fd != -1) {
+        ReportMeasure(&measure, report_fd);
+    }
+    FreeMeasure(&measure);
+
+    if (save1 != NULL) {
+        SaveMatrix(&matrix1, save1);
+    }
+    if (save2 != NULL) {
+        SaveMatrix(&matrix2, save2);
+    }
+
+    free(threads);
+    free(thread_args);
+    FreeScheduler(&scheduler);
+    FreePublish();
+
+    if (placement.pinned) {
+        ReportMemoryNodes("matrix1", matrix1.re, MatrixBytes(&matrix1));
+        ReportMemoryNodes("упакованной matrix2", packed.panels, packed.planes * packed.plane_size * sizeof(double));
+        ReportMemoryNodes("результата", result.re, MatrixBytes(&result));
+    }
+    FreePlacement(&placement);
+
+    if (CurrentGemmMethod() == GEMM_3M) {
+        ReportMethodError(&matrix1, &matrix2, &result);
+    }
+
+    if (output != NULL) {
+        SaveMatrix(&result, output);
+    } else {
+        WriteMatrixText(STDOUT_FILENO, &result);
+    }
+
+    FreeMatrix(&matrix1);
+    FreeMatrix(&matrix2);
+    FreePackedMatrix(&packed);
+    FreeMatrix(&result);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,21 @@
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include "gemm.h"
+#include "scheduler.h"
+
+// Общая программа вариантов mutex, atomic и lockfree (driver.c): разбор аргументов, генерация или загрузка
+// входов, размещение потоков, замер и вывод результата. Варианты отличаются только тем, как поток переносит
+// посчитанный блок в общий результат, -- каждый определяет VARIANT_NAME, InitPublish, FreePublish
+// и PublishBlock.
+
+extern const char VARIANT_NAME[];
+
+void InitPublish(void);
+void FreePublish(void);
+
+// Переносит блок tile из workspace->tile_re/tile_im (строки с шагом GEMM_NC) в result. Вызывается всеми
+// потоками одновременно; блоки разных вызовов не пересекаются. Результат читается после pthread_join.
+void PublishBlock(Matrix *result, const Tile *tile, const GemmWorkspace *workspace);
+
+#endif
@@ -0,0 +1,227 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gemm.h"
+
+#define ERROR_CHECK_ROWS 8
+
+static GemmMethod method = GEMM_4M;
+
+void SelectGemmMethod(void) {
+    const char *name = getenv("GEMM_METHOD");
+
+    if (name == NULL || strcmp(name, "4m") == 0) {
+        method = GEMM_4M;
+    } else if (strcmp(name, "3m") == 0) {
+        method = GEMM_3M;
+    } else {
+        HandleError("Ошибка: неизвестный метод в GEMM_METHOD (4m, 3m).\n");
+    }
+}
+
+GemmMethod CurrentGemmMethod(void) {
+    return method;
+}
+
+static double *AllocateAligned(size_t bytes) {
+    void *memory = NULL;
+    if (posix_memalign(&memory, 64, bytes) != 0) {
+        HandleError("Ошибка выделения памяти для упакованной матрицы.\n");
+    }
+    return memory;
+}
+
+void AllocatePackedMatrix(PackedMatrix *packed, const Matrix *matrix) {
+    const GemmKernel *kernel = CurrentGemmKernel();
+    size_t size = matrix->rows;
+    size_t nr = method == GEMM_3M ? kernel->real_nr : kernel->nr;
+    size_t panel_count = (size + nr - 1) / nr;
+
+    packed->size = size;
+    packed->nr = nr;
+    packed->planes = method == GEMM_3M ? 3 : 2;
+    packed->plane_size = panel_count * size * nr;
+    packed->panels = AllocateAligned(packed->planes * packed->plane_size * sizeof(double));
+}
+
+void PackPanels(PackedMatrix *packed, const Matrix *matrix, size_t part, size_t parts) {
+    size_t size = packed->size;
+    size_t nr = packed->nr;
+    size_t plane_size = packed->plane_size;
+    size_t panel_count = (size + nr - 1) / nr;
+
+    for (size_t panel = panel_count * part / parts; panel < panel_count * (part + 1) / parts; panel++) {
+        size_t first = panel * nr;
+
+        for (size_t k = 0; k < size; k++) {
+            for (size_t c = 0; c < nr; c++) {
+                // Хвостовые столбцы последней панели -- нули, микроядру не нужны проверки границ.
+                int inside = first + c < size;
+                double real = inside ? MATRIX_RE(matrix, k, first + c) : 0;
+                double imag = inside ? MATRIX_IM(matrix, k, first + c) : 0;
+
+                if (packed->planes == 3) {
+                    size_t offset = (panel * size + k) * nr + c;
+                    packed->panels[offset] = real;
+                    packed->panels[plane_size + offset] = imag;
+                    packed->panels[2 * plane_size + offset] = real + imag;
+                } else {
+                    size_t offset = (panel * size + k) * 2 * nr + c;
+                    packed->panels[offset] = real;
+                    packed->panels[offset + nr] = imag;
+                }
+            }
+        }
+    }
+}
+
+void FreePackedMatrix(PackedMatrix *packed) {
+    free(packed->panels);
+}
+
+void AllocateWorkspace(GemmWorkspace *workspace) {
+    workspace->packed_rows = AllocateAligned(GEMM_MC * GEMM_KC * 3 * sizeof(double));
+    workspace->tile_re = AllocateAligned(GEMM_MC * GEMM_NC * 3 * sizeof(double));
+    workspace->tile_im = workspace->tile_re + GEMM_MC * GEMM_NC;
+    workspace->tile_sum = workspace->tile_im + GEMM_MC * GEMM_NC;
+}
+
+void FreeWorkspace(GemmWorkspace *workspace) {
+    free(workspace->packed_rows);
+    free(workspace->tile_re);
+}
+
+// Упаковывает matrix1[row..row+rows) x [k0..k0+depth) полосами по mr строк, недостающие строки -- нули.
+// Строки matrix1 читаются подряд, в блок пишутся с шагом mr (в 4M -- 2 * mr, re и im вперемежку).
+static void PackRows(double *out, size_t mr, const Matrix *matrix1, size_t row, size_t rows, size_t k0,
+                     size_t depth) {
+    for (size_t strip = 0; strip < rows; strip += mr) {
+        double *block = out + strip * depth * 2;
+        for (size_t r = 0; r < mr; r++) {
+            int inside = strip + r < rows;
+            for (size_t k = 0; k < depth; k++) {
+                block[k * 2 * mr + r] = inside ? MATRIX_RE(matrix1, row + strip + r, k0 + k) : 0;
+                block[k * 2 * mr + mr + r] = inside ? MATRIX_IM(matrix1, row + strip + r, k0 + k) : 0;
+            }
+        }
+    }
+}
+
+// То же для режима 3M: три вещественных блока re, im и re + im по GEMM_MC * GEMM_KC элементов.
+static void PackRowPlanes(double *out, size_t mr, const Matrix *matrix1, size_t row, size_t rows, size_t k0,
+                          size_t depth) {
+    for (size_t strip = 0; strip < rows; strip += mr) {
+        double *block = out + strip * depth;
+        for (size_t r = 0; r < mr; r++) {
+            int inside = strip + r < rows;
+            for (size_t k = 0; k < depth; k++) {
+                double real = inside ? MATRIX_RE(matrix1, row + strip + r, k0 + k) : 0;
+                double imag = inside ? MATRIX_IM(matrix1, row + strip + r, k0 + k) : 0;
+                block[k * mr + r] = real;
+                block[GEMM_MC * GEMM_KC + k * mr + r] = imag;
+                block[2 * GEMM_MC * GEMM_KC + k * mr + r] = real + imag;
+            }
+        }
+    }
+}
+
+// Режим 3M: tile_re += ArBr, tile_im += AiBi, tile_sum += (Ar+Ai)(Br+Bi) -- три вещественных умножения.
+static void MultiplyPlanes(const GemmKernel *kernel, const PackedMatrix *matrix2, size_t k0, size_t depth,
+                           size_t rows, size_t col, size_t cols, GemmWorkspace *workspace) {
+    double *tiles[3] = {workspace->tile_re, workspace->tile_im, workspace->tile_sum};
+    size_t mr = kernel->real_mr;
+    size_t nr = matrix2->nr;
+
+    for (size_t plane = 0; plane < 3; plane++) {
+        const double *rows_block = workspace->packed_rows + plane * GEMM_MC * GEMM_KC;
+        const double *panels = matrix2->panels + plane * matrix2->plane_size;
+        for (size_t c = 0; c < cols; c += nr) {
+            const double *panel = panels + ((col + c) / nr * matrix2->size + k0) * nr;
+            for (size_t r = 0; r < rows; r += mr) {
+                kernel->run_real(depth, rows_block + r * depth, panel, tiles[plane] + r * GEMM_NC + c);
+            }
+        }
+    }
+}
+
+void MultiplyBlock(const Matrix *matrix1, const PackedMatrix *matrix2, size_t row, size_t rows, size_t col, size_t cols,
+                   GemmWorkspace *workspace) {
+    const GemmKernel *kernel = CurrentGemmKernel();
+    size_t size = matrix2->size;
+    size_t nr = matrix2->nr;
+    size_t mr = method == GEMM_3M ? kernel->real_mr : kernel->mr;
+    size_t planes = method == GEMM_3M ? 3 : 2;
+
+    memset(workspace->tile_re, 0, GEMM_MC * GEMM_NC * planes * sizeof(double));
+
+    for (size_t k0 = 0; k0 < size; k0 += GEMM_KC) {
+        size_t depth = size - k0 < GEMM_KC ? size - k0 : GEMM_KC;
+
+        if (method == GEMM_3M) {
+            PackRowPlanes(workspace->packed_rows, mr, matrix1, row, rows, k0, depth);
+            MultiplyPlanes(kernel, matrix2, k0, depth, rows, col, cols, workspace);
+            continue;
+        }
+
+        PackRows(workspace->packed_rows, mr, matrix1, row, rows, k0, depth);
+        for (size_t c = 0; c < cols; c += nr) {
+            const double *panel = matrix2->panels + ((col + c) / nr * size + k0) * 2 * nr;
+            for (size_t r = 0; r < rows; r += mr) {
+                size_t offset = r * GEMM_NC + c;
+                kernel->run(depth, workspace->packed_rows + r * depth * 2, panel, workspace->tile_re + offset,
+                            workspace->tile_im + offset);
+            }
+        }
+    }
+
+    if (method == GEMM_3M) {
+        // Cr = ArBr - AiBi, Ci = (Ar+Ai)(Br+Bi) - ArBr - AiBi.
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t j = 0; j < cols; j++) {
+                size_t offset = i * GEMM_NC + j;
+                double real = workspace->tile_re[offset];
+                double imag = workspace->tile_im[offset];
+                workspace->tile_re[offset] = real - imag;
+                workspace->tile_im[offset] = workspace->tile_sum[offset] - real - imag;
+            }
+        }
+    }
+}
+
+void ReportMethodError(const Matrix *matrix1, const Matrix *matrix2, const Matrix *result) {
+    size_t size = result->rows;
+    size_t checked = size < ERROR_CHECK_ROWS ? size : ERROR_CHECK_ROWS;
+    double max_error = 0;
+    double max_value = 0;
+
+    // Строки берутся равномерно по всей матрице; эталон -- прямое 4M-умножение без блоков.
+    for (size_t n = 0; n < checked; n++) {
+        size_t i = n * size / checked;
+        for (size_t j = 0; j < size; j++) {
+            double real = 0;
+            double imag = 0;
+            for (size_t k = 0; k < size; k++) {
+                double a_re = MATRIX_RE(matrix1, i, k);
+                double a_im = MATRIX_IM(matrix1, i, k);
+                double b_re = MATRIX_RE(matrix2, k, j);
+                double b_im = MATRIX_IM(matrix2, k, j);
+                real += a_re * b_re - a_im * b_im;
+                imag += a_re * b_im + a_im * b_re;
+            }
+
+            double error = hypot(MATRIX_RE(result, i, j) - real, MATRIX_IM(result, i, j) - imag);
+            double value = hypot(real, imag);
+            max_error = error > max_error ? error : max_error;
+            max_value = value > max_value ? value : max_value;
+        }
+    }
+
+    char buffer[256];
+    int length = snprintf(buffer, sizeof(buffer),
+                          "Погрешность %s относительно 4M (%zu строк): абсолютная %.3e, относительная %.3e\n",
+                          method == GEMM_3M ? "3M" : "4M", checked, max_error, max_value > 0 ? max_error / max_value : 0);
+    write(STDERR_FILENO, buffer, length);
+}
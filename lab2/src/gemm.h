@@ -0,0 +1,89 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include "matrix.h"
+
+// Блочное умножение комплексных матриц для mutex и atomic.
+// matrix2 заранее упаковывается в панели по nr столбцов: для каждого k подряд лежат nr вещественных
+// и nr мнимых частей, так что внутренний цикл читает память строго подряд.
+// Поток считает результат блоками GEMM_MC x GEMM_NC: строки matrix1 упаковываются так же, по mr,
+// кусками по GEMM_KC, а микроядро mr x nr держит суммы в регистрах.
+// Размеры подобраны так, чтобы кусок панели B (GEMM_KC x nr) жил в L1, а упакованный блок A -- в L2.
+//
+// Микроядро (скалярное, SSE2, AVX2 или AVX-512, со своими mr и nr) выбирается при запуске по cpuid в
+// SelectGemmKernel, после самопроверки против эталонной реализации. Переменная окружения GEMM_KERNEL
+// задаёт ядро явно. GEMM_MC и GEMM_NC кратны mr и nr всех ядер.
+
+#define GEMM_MC 64
+#define GEMM_KC 256
+#define GEMM_NC 256
+
+// tile += A(mr x depth) * B(depth x nr); строки тайла идут с шагом GEMM_NC.
+typedef void (*MicroKernelFunc)(size_t depth, const double *a, const double *b, double *tile_re, double *tile_im);
+// tile += A(real_mr x depth) * B(depth x real_nr) для вещественных матриц режима 3M.
+typedef void (*RealKernelFunc)(size_t depth, const double *a, const double *b, double *tile);
+
+typedef struct {
+    const char *name;
+    size_t mr;
+    size_t nr;
+    MicroKernelFunc run;
+    size_t real_mr;
+    size_t real_nr;
+    RealKernelFunc run_real;
+    int (*supported)(void);
+} GemmKernel;
+
+// GEMM_4M -- обычное комплексное умножение, 4 вещественных умножения на пару элементов.
+// GEMM_3M -- умножение по Гауссу: три вещественных произведения ArBr, AiBi и (Ar+Ai)(Br+Bi), из которых
+// Cr = ArBr - AiBi и Ci = (Ar+Ai)(Br+Bi) - ArBr - AiBi. Работы на четверть меньше, но вычитание больших
+// близких чисел теряет точность, поэтому в этом режиме печатается погрешность относительно 4M.
+// Выбирается переменной окружения GEMM_METHOD=3m.
+typedef enum {
+    GEMM_4M,
+    GEMM_3M
+} GemmMethod;
+
+// В режиме 3M вместо комплексных панелей -- три вещественные матрицы re, im и re + im, каждая упакована
+// панелями по real_nr столбцов и занимает plane_size элементов.
+typedef struct {
+    size_t size;
+    size_t nr;
+    size_t planes;
+    size_t plane_size;
+    double *panels;
+} PackedMatrix;
+
+// Буферы потока: упакованный блок строк matrix1 и блок результата, плоскостями re и im
+// (в режиме 3M ещё tile_sum для (Ar+Ai)(Br+Bi), а строки matrix1 -- тремя вещественными блоками).
+typedef struct {
+    double *packed_rows;
+    double *tile_re;
+    double *tile_im;
+    double *tile_sum;
+} GemmWorkspace;
+
+// Вызываются до AllocatePackedMatrix: раскладка панелей зависит от ядра и метода.
+void SelectGemmKernel(void);
+const GemmKernel *CurrentGemmKernel(void);
+void SelectGemmMethod(void);
+GemmMethod CurrentGemmMethod(void);
+
+// Упаковка разбита на части, чтобы каждый поток заполнял свою долю панелей (и страницы с ней
+// оказывались на его узле NUMA): PackPanels упаковывает часть part из parts.
+void AllocatePackedMatrix(PackedMatrix *packed, const Matrix *matrix);
+void PackPanels(PackedMatrix *packed, const Matrix *matrix, size_t part, size_t parts);
+void FreePackedMatrix(PackedMatrix *packed);
+void AllocateWorkspace(GemmWorkspace *workspace);
+void FreeWorkspace(GemmWorkspace *workspace);
+
+// Считает result[row..row+rows) x [col..col+cols) в workspace->tile_re/tile_im, строки тайла идут с шагом
+// GEMM_NC. rows <= GEMM_MC, cols <= GEMM_NC.
+void MultiplyBlock(const Matrix *matrix1, const PackedMatrix *matrix2, size_t row, size_t rows, size_t col, size_t cols,
+                   GemmWorkspace *workspace);
+
+// Пересчитывает несколько строк result обычным комплексным умножением и печатает в stderr
+// максимальную абсолютную и относительную погрешность.
+void ReportMethodError(const Matrix *matrix1, const Matrix *matrix2, const Matrix *result);
+
+#endif
@@ -0,0 +1,33 @@
+#include "generator.h"
+
+#define SPLITMIX_GAMMA 0x9E3779B97F4A7C15ULL
+
+static inline uint64_t Mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// Целое из [-GENERATOR_RANGE, GENERATOR_RANGE] по старшим 32 битам, умножением вместо деления.
+static inline double ToElement(uint64_t bits) {
+    return (double)(((bits >> 32) * (2 * GENERATOR_RANGE + 1)) >> 32) - GENERATOR_RANGE;
+}
+
+void FillRandomRows(Matrix *matrix, uint64_t seed, unsigned stream, size_t first, size_t last) {
+    // Ключ перемешивается, чтобы потоки соседних seed не были сдвигами одной последовательности.
+    uint64_t key = Mix64(seed ^ ((uint64_t)stream * SPLITMIX_GAMMA));
+
+    for (size_t i = first; i < last; i++) {
+        // Номер пары (re, im) -- i * cols + j, на элемент уходит два выхода splitmix64.
+        uint64_t state = key + 2 * (uint64_t)(i * matrix->cols) * SPLITMIX_GAMMA;
+        for (size_t j = 0; j < matrix->cols; j++) {
+            MATRIX_RE(matrix, i, j) = ToElement(Mix64(state += SPLITMIX_GAMMA));
+            MATRIX_IM(matrix, i, j) = ToElement(Mix64(state += SPLITMIX_GAMMA));
+        }
+        // Хвост строки до stride обнуляется, чтобы SaveMatrix не записала в файл мусор.
+        for (size_t j = matrix->cols; j < matrix->stride / matrix->step; j++) {
+            MATRIX_RE(matrix, i, j) = 0;
+            MATRIX_IM(matrix, i, j) = 0;
+        }
+    }
+}
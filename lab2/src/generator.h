@@ -0,0 +1,18 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <stdint.h>
+
+#include "matrix.h"
+
+// Счётчиковый генератор случайных элементов: значение элемента (i, j) матрицы stream зависит только от
+// (seed, stream, i, j) -- это выход splitmix64 с номером, вычисленным по этим координатам, без общего
+// состояния. Поэтому строки можно заполнять в любом порядке и любым числом потоков, а при одном seed
+// матрицы получаются побитово одинаковыми. Элементы -- целые re и im из [-GENERATOR_RANGE, GENERATOR_RANGE].
+
+#define GENERATOR_RANGE 10
+
+// Заполняет строки [first, last).
+void FillRandomRows(Matrix *matrix, uint64_t seed, unsigned stream, size_t first, size_t last);
+
+#endif
@@ -0,0 +1,496 @@
+#include <immintrin.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gemm.h"
+
+#define SELF_TEST_DEPTH 67
+#define SELF_TEST_TOLERANCE 1e-12
+
+// Эталон: те же формулы без развёртки и векторов, размер тайла задаётся параметрами.
+static void ReferenceKernel(size_t mr, size_t nr, size_t depth, const double *a, const double *b, double *tile_re,
+                            double *tile_im) {
+    for (size_t k = 0; k < depth; k++, a += 2 * mr, b += 2 * nr) {
+        for (size_t r = 0; r < mr; r++) {
+            for (size_t c = 0; c < nr; c++) {
+                tile_re[r * GEMM_NC + c] += a[r] * b[c] - a[mr + r] * b[nr + c];
+                tile_im[r * GEMM_NC + c] += a[r] * b[nr + c] + a[mr + r] * b[c];
+            }
+        }
+    }
+}
+
+// Эталон вещественного ядра для режима 3M: tile += A * B.
+static void ReferenceRealKernel(size_t mr, size_t nr, size_t depth, const double *a, const double *b, double *tile) {
+    for (size_t k = 0; k < depth; k++, a += mr, b += nr) {
+        for (size_t r = 0; r < mr; r++) {
+            for (size_t c = 0; c < nr; c++) {
+                tile[r * GEMM_NC + c] += a[r] * b[c];
+            }
+        }
+    }
+}
+
+// Скалярное ядро 2x4. Комплексное умножение расписано вручную: обычное `*` для double complex уходит
+// в __muldc3 с обработкой NaN/Inf. Циклы развёрнуты полностью, чтобы суммы жили в регистрах.
+#define SCALAR_MR 2
+#define SCALAR_NR 4
+
+static void ScalarKernel(size_t depth, const double *a, const double *b, double *tile_re, double *tile_im) {
+    double sum_re[SCALAR_MR][SCALAR_NR];
+    double sum_im[SCALAR_MR][SCALAR_NR];
+
+#pragma GCC unroll 8
+    for (size_t r = 0; r < SCALAR_MR; r++) {
+#pragma GCC unroll 8
+        for (size_t c = 0; c < SCALAR_NR; c++) {
+            sum_re[r][c] = tile_re[r * GEMM_NC + c];
+            sum_im[r][c] = tile_im[r * GEMM_NC + c];
+        }
+    }
+
+    for (size_t k = 0; k < depth; k++, a += 2 * SCALAR_MR, b += 2 * SCALAR_NR) {
+#pragma GCC unroll 8
+        for (size_t r = 0; r < SCALAR_MR; r++) {
+            double a_re = a[r];
+            double a_im = a[SCALAR_MR + r];
+#pragma GCC unroll 8
+            for (size_t c = 0; c < SCALAR_NR; c++) {
+                sum_re[r][c] += a_re * b[c] - a_im * b[SCALAR_NR + c];
+                sum_im[r][c] += a_re * b[SCALAR_NR + c] + a_im * b[c];
+            }
+        }
+    }
+
+#pragma GCC unroll 8
+    for (size_t r = 0; r < SCALAR_MR; r++) {
+#pragma GCC unroll 8
+        for (size_t c = 0; c < SCALAR_NR; c++) {
+            tile_re[r * GEMM_NC + c] = sum_re[r][c];
+            tile_im[r * GEMM_NC + c] = sum_im[r][c];
+        }
+    }
+}
+
+// Векторные ядра устроены одинаково: суммы -- MR x (NR / ширина) векторов на плоскость, на каждом k
+// читается строка панели B (re и im) и по два broadcast на строку A. У FMA-вариантов
+// re += a_re * b_re - a_im * b_im и im += a_re * b_im + a_im * b_re -- четыре FMA.
+
+// SSE2, 2x4: 8 регистров сумм из 16.
+#define SSE2_MR 2
+#define SSE2_NR 4
+#define SSE2_VECTORS (SSE2_NR / 2)
+
+__attribute__((target("sse2"))) static void Sse2Kernel(size_t depth, const double *a, const double *b, double *tile_re,
+                                                        double *tile_im) {
+    __m128d sum_re[SSE2_MR][SSE2_VECTORS];
+    __m128d sum_im[SSE2_MR][SSE2_VECTORS];
+
+#pragma GCC unroll 8
+    for (size_t r = 0; r < SSE2_MR; r++) {
+#pragma GCC unroll 8
+        for (size_t v = 0; v < SSE2_VECTORS; v++) {
+            sum_re[r][v] = _mm_loadu_pd(tile_re + r * GEMM_NC + 2 * v);
+            sum_im[r][v] = _mm_loadu_pd(tile_im + r * GEMM_NC + 2 * v);
+        }
+    }
+
+    for (size_t k = 0; k < depth; k++, a += 2 * SSE2_MR, b += 2 * SSE2_NR) {
+        __m128d b_re[SSE2_VECTORS];
+        __m128d b_im[SSE2_VECTORS];
+#pragma GCC unroll 8
+        for (size_t v = 0; v < SSE2_VECTORS; v++) {
+            b_re[v] = _mm_loadu_pd(b + 2 * v);
+            b_im[v] = _mm_loadu_pd(b + SSE2_NR + 2 * v);
+        }
+#pragma GCC unroll 8
+        for (size_t r = 0; r < SSE2_MR; r++) {
+            __m128d a_re = _mm_set1_pd(a[r]);
+            __m128d a_im = _mm_set1_pd(a[SSE2_MR + r]);
+#pragma GCC unroll 8
+            for (size_t v = 0; v < SSE2_VECTORS; v++) {
+                sum_re[r][v] = _mm_add_pd(sum_re[r][v], _mm_sub_pd(_mm_mul_pd(a_re, b_re[v]), _mm_mul_pd(a_im, b_im[v])));
+                sum_im[r][v] = _mm_add_pd(sum_im[r][v], _mm_add_pd(_mm_mul_pd(a_re, b_im[v]), _mm_mul_pd(a_im, b_re[v])));
+            }
+        }
+    }
+
+#pragma GCC unroll 8
+    for (size_t r = 0; r < SSE2_MR; r++) {
+#pragma GCC unroll 8
+        for (size_t v = 0; v < SSE2_VECTORS; v++) {
+            _mm_storeu_pd(tile_re + r * GEMM_NC + 2 * v, sum_re[r][v]);
+            _mm_storeu_pd(tile_im + r * GEMM_NC + 2 * v, sum_im[r][v]);
+        }
+    }
+}
+
+// AVX2 + FMA, 2x8: 8 регистров сумм, 4 под строку B, 2 под broadcast.
+#define AVX2_MR 2
+#define AVX2_NR 8
+#define AVX2_VECTORS (AVX2_NR / 4)
+
+__attribute__((target("avx2,fma"))) static void Avx2Kernel(size_t depth, const double *a, const double *b,
+                                                            double *tile_re, double *tile_im) {
+    __m256d sum_re[AVX2_MR][AVX2_VECTORS];
+    __m256d sum_im[AVX2_MR][AVX2_VECTORS];
+
+#pragma GCC unroll 8
+    for (size_t r = 0; r < AVX2_MR; r++) {
+#pragma GCC unroll 8
+        for (size_t v = 0; v < AVX2_VECTORS; v++) {
+            sum_re[r][v] = _mm256_loadu_pd(tile_re + r * GEMM_NC + 4 * v);
+            sum_im[r][v] = _mm256_loadu_pd(tile_im + r * GEMM_NC + 4 * v);
+        }
+    }
+
+    for (size_t k = 0; k < depth; k++, a += 2 * AVX2_MR, b += 2 * AVX2_NR) {
+        __m256d b_re[AVX2_VECTORS];
+        __m256d b_im[AVX2_VECTORS];
+#pragma GCC unroll 8
+        for (size_t v = 0; v < AVX2_VECTORS; v++) {
+            b_re[v] = _mm256_loadu_pd(b + 4 * v);
+            b_im[v] = _mm256_loadu_pd(b + AVX2_NR + 4 * v);
+        }
+#pragma GCC unroll 8
+        for (size_t r = 0; r < AVX2_MR; r++) {
+            __m256d a_re = _mm256_broadcast_sd(a + r);
+            __m256d a_im = _mm256_broadcast_sd(a + AVX2_MR + r);
+#pragma GCC unroll 8
+            for (size_t v = 0; v < AVX2_VECTORS; v++) {
+                sum_re[r][v] = _mm256_fnmadd_pd(a_im, b_im[v], _mm256_fmadd_pd(a_re, b_re[v], sum_re[r][v]));
+                sum_im[r][v] = _mm256_fmadd_pd(a_im, b_re[v], _mm256_fmadd_pd(a_re, b_im[v], sum_im[r][v]));
+            }
+        }
+    }
+
+#pragma GCC unroll 8
+    for (size_t r = 0; r < AVX2_MR; r++) {
+#pragma GCC unroll 8
+        for (size_t v = 0; v < AVX2_VECTORS; v++) {
+            _mm256_storeu_pd(tile_re + r * GEMM_NC + 4 * v, sum_re[r][v]);
+            _mm256_storeu_pd(tile_im + r * GEMM_NC + 4 * v, sum_im[r][v]);
+        }
+    }
+}
+
+// AVX-512, 4x16: 16 регистров сумм из 32.
+#define AVX512_MR 4
+#define AVX512_NR 16
+#define AVX512_VECTORS (AVX512_NR / 8)
+
+__attribute__((target("avx512f"))) static void Avx512Kernel(size_t depth, const double *a, const double *b,
+                                                             double *tile_re, double *tile_im) {
+    __m512d sum_re[AVX512_MR][AVX512_VECTORS];
+    __m512d sum_im[AVX512_MR][AVX512_VECTORS];
+
+#pragma GCC unroll 8
+    for (size_t r = 0; r < AVX512_MR; r++) {
+#pragma GCC unroll 8
+        for (size_t v = 0; v < AVX512_VECTORS; v++) {
+            sum_re[r][v] = _mm512_loadu_pd(tile_re + r * GEMM_NC + 8 * v);
+            sum_im[r][v] = _mm512_loadu_pd(tile_im + r * GEMM_NC + 8 * v);
+        }
+    }
+
+    for (size_t k = 0; k < depth; k++, a += 2 * AVX512_MR, b += 2 * AVX512_NR) {
+        __m512d b_re[AVX512_VECTORS];
+        __m512d b_im[AVX512_VECTORS];
+#pragma GCC unroll 8
+        for (size_t v = 0; v < AVX512_VECTORS; v++) {
+            b_re[v] = _mm512_loadu_pd(b + 8 * v);
+            b_im[v] = _mm512_loadu_pd(b + AVX512_NR + 8 * v);
+        }
+#pragma GCC unroll 8
+        for (size_t r = 0; r < AVX512_MR; r++) {
+            __m512d a_re = _mm512_set1_pd(a[r]);
+            __m512d a_im = _mm512_set1_pd(a[AVX512_MR + r]);
+#pragma GCC unroll 8
+            for (size_t v = 0; v < AVX512_VECTORS; v++) {
+                sum_re[r][v] = _mm512_fnmadd_pd(a_im, b_im[v], _mm512_fmadd_pd(a_re, b_re[v], sum_re[r][v]));
+                sum_im[r][v] = _mm512_fmadd_pd(a_im, b_re[v], _mm512_fmadd_pd(a_re, b_im[v], sum_im[r][v]));
+            }
+        }
+    }
+
+#pragma GCC unroll 8
+    for (size_t r = 0; r < AVX512_MR; r++) {
+#pragma GCC unroll 8
+        for (size_t v = 0; v < AVX512_VECTORS; v++) {
+            _mm512_storeu_pd(tile_re + r * GEMM_NC + 8 * v, sum_re[r][v]);
+            _mm512_storeu_pd(tile_im + r * GEMM_NC + 8 * v, sum_im[r][v]);
+        }
+    }
+}
+
+// Вещественные ядра для режима 3M (см. gemm.h): tile += A * B по одной плоскости. Тайл у них свой и
+// крупнее комплексного: на каждую загруженную строку B приходится больше FMA.
+
+#define SCALAR_REAL_MR 4
+#define SCALAR_REAL_NR 4
+
+static void ScalarRealKernel(size_t depth, const double *a, const double *b, double *tile) {
+    double sum[SCALAR_REAL_MR][SCALAR_REAL_NR];
+
+#pragma GCC unroll 8
+    for (size_t r = 0; r < SCALAR_REAL_MR; r++) {
+#pragma GCC unroll 8
+        for (size_t c = 0; c < SCALAR_REAL_NR; c++) {
+            sum[r][c] = tile[r * GEMM_NC + c];
+        }
+    }
+
+    for (size_t k = 0; k < depth; k++, a += SCALAR_REAL_MR, b += SCALAR_REAL_NR) {
+#pragma GCC unroll 8
+        for (size_t r = 0; r < SCALAR_REAL_MR; r++) {
+#pragma GCC unroll 8
+            for (size_t c = 0; c < SCALAR_REAL_NR; c++) {
+                sum[r][c] += a[r] * b[c];
+            }
+        }
+    }
+
+#pragma GCC unroll 8
+    for (size_t r = 0; r < SCALAR_REAL_MR; r++) {
+#pragma GCC unroll 8
+        for (size_t c = 0; c < SCALAR_REAL_NR; c++) {
+            tile[r * GEMM_NC + c] = sum[r][c];
+        }
+    }
+}
+
+// SSE2, 4x4: 8 регистров сумм.
+#define SSE2_REAL_MR 4
+#define SSE2_REAL_NR 4
+#define SSE2_REAL_VECTORS (SSE2_REAL_NR / 2)
+
+__attribute__((target("sse2"))) static void Sse2RealKernel(size_t depth, const double *a, const double *b,
+                                                           double *tile) {
+    __m128d sum[SSE2_REAL_MR][SSE2_REAL_VECTORS];
+
+#pragma GCC unroll 8
+    for (size_t r = 0; r < SSE2_REAL_MR; r++) {
+#pragma GCC unroll 8
+        for (size_t v = 0; v < SSE2_REAL_VECTORS; v++) {
+            sum[r][v] = _mm_loadu_pd(tile + r * GEMM_NC + 2 * v);
+        }
+    }
+
+    for (size_t k = 0; k < depth; k++, a += SSE2_REAL_MR, b += SSE2_REAL_NR) {
+        __m128d b_row[SSE2_REAL_VECTORS];
+#pragma GCC unroll 8
+        for (size_t v = 0; v < SSE2_REAL_VECTORS; v++) {
+            b_row[v] = _mm_loadu_pd(b + 2 * v);
+        }
+#pragma GCC unroll 8
+        for (size_t r = 0; r < SSE2_REAL_MR; r++) {
+            __m128d a_value = _mm_set1_pd(a[r]);
+#pragma GCC unroll 8
+            for (size_t v = 0; v < SSE2_REAL_VECTORS; v++) {
+                sum[r][v] = _mm_add_pd(sum[r][v], _mm_mul_pd(a_value, b_row[v]));
+            }
+        }
+    }
+
+#pragma GCC unroll 8
+    for (size_t r = 0; r < SSE2_REAL_MR; r++) {
+#pragma GCC unroll 8
+        for (size_t v = 0; v < SSE2_REAL_VECTORS; v++) {
+            _mm_storeu_pd(tile + r * GEMM_NC + 2 * v, sum[r][v]);
+        }
+    }
+}
+
+// AVX2 + FMA, 4x8: 8 регистров сумм.
+#define AVX2_REAL_MR 4
+#define AVX2_REAL_NR 8
+#define AVX2_REAL_VECTORS (AVX2_REAL_NR / 4)
+
+__attribute__((target("avx2,fma"))) static void Avx2RealKernel(size_t depth, const double *a, const double *b,
+                                                               double *tile) {
+    __m256d sum[AVX2_REAL_MR][AVX2_REAL_VECTORS];
+
+#pragma GCC unroll 8
+    for (size_t r = 0; r < AVX2_REAL_MR; r++) {
+#pragma GCC unroll 8
+        for (size_t v = 0; v < AVX2_REAL_VECTORS; v++) {
+            sum[r][v] = _mm256_loadu_pd(tile + r * GEMM_NC + 4 * v);
+        }
+    }
+
+    for (size_t k = 0; k < depth; k++, a += AVX2_REAL_MR, b += AVX2_REAL_NR) {
+        __m256d b_row[AVX2_REAL_VECTORS];
+#pragma GCC unroll 8
+        for (size_t v = 0; v < AVX2_REAL_VECTORS; v++) {
+            b_row[v] = _mm256_loadu_pd(b + 4 * v);
+        }
+#pragma GCC unroll 8
+        for (size_t r = 0; r < AVX2_REAL_MR; r++) {
+            __m256d a_value = _mm256_broadcast_sd(a + r);
+#pragma GCC unroll 8
+            for (size_t v = 0; v < AVX2_REAL_VECTORS; v++) {
+                sum[r][v] = _mm256_fmadd_pd(a_value, b_row[v], sum[r][v]);
+            }
+        }
+    }
+
+#pragma GCC unroll 8
+    for (size_t r = 0; r < AVX2_REAL_MR; r++) {
+#pragma GCC unroll 8
+        for (size_t v = 0; v < AVX2_REAL_VECTORS; v++) {
+            _mm256_storeu_pd(tile + r * GEMM_NC + 4 * v, sum[r][v]);
+        }
+    }
+}
+
+// AVX-512, 8x16: 16 регистров сумм.
+#define AVX512_REAL_MR 8
+#define AVX512_REAL_NR 16
+#define AVX512_REAL_VECTORS (AVX512_REAL_NR / 8)
+
+__attribute__((target("avx512f"))) static void Avx512RealKernel(size_t depth, const double *a, const double *b,
+                                                                double *tile) {
+    __m512d sum[AVX512_REAL_MR][AVX512_REAL_VECTORS];
+
+#pragma GCC unroll 8
+    for (size_t r = 0; r < AVX512_REAL_MR; r++) {
+#pragma GCC unroll 8
+        for (size_t v = 0; v < AVX512_REAL_VECTORS; v++) {
+            sum[r][v] = _mm512_loadu_pd(tile + r * GEMM_NC + 8 * v);
+        }
+    }
+
+    for (size_t k = 0; k < depth; k++, a += AVX512_REAL_MR, b += AVX512_REAL_NR) {
+        __m512d b_row[AVX512_REAL_VECTORS];
+#pragma GCC unroll 8
+        for (size_t v = 0; v < AVX512_REAL_VECTORS; v++) {
+            b_row[v] = _mm512_loadu_pd(b + 8 * v);
+        }
+#pragma GCC unroll 8
+        for (size_t r = 0; r < AVX512_REAL_MR; r++) {
+            __m512d a_value = _mm512_set1_pd(a[r]);
+#pragma GCC unroll 8
+            for (size_t v = 0; v < AVX512_REAL_VECTORS; v++) {
+                sum[r][v] = _mm512_fmadd_pd(a_value, b_row[v], sum[r][v]);
+            }
+        }
+    }
+
+#pragma GCC unroll 8
+    for (size_t r = 0; r < AVX512_REAL_MR; r++) {
+#pragma GCC unroll 8
+        for (size_t v = 0; v < AVX512_REAL_VECTORS; v++) {
+            _mm512_storeu_pd(tile + r * GEMM_NC + 8 * v, sum[r][v]);
+        }
+    }
+}
+
+static int ScalarSupported(void) {
+    return 1;
+}
+
+static int Sse2Supported(void) {
+    return __builtin_cpu_supports("sse2");
+}
+
+static int Avx2Supported(void) {
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+static int Avx512Supported(void) {
+    return __builtin_cpu_supports("avx512f");
+}
+
+// От лучшего к худшему: SelectGemmKernel берёт первое ядро, которое процессор поддерживает и которое
+// прошло самопроверку.
+static const GemmKernel kernels[] = {
+    {"avx512", AVX512_MR, AVX512_NR, Avx512Kernel, AVX512_REAL_MR, AVX512_REAL_NR, Avx512RealKernel, Avx512Supported},
+    {"avx2", AVX2_MR, AVX2_NR, Avx2Kernel, AVX2_REAL_MR, AVX2_REAL_NR, Avx2RealKernel, Avx2Supported},
+    {"sse2", SSE2_MR, SSE2_NR, Sse2Kernel, SSE2_REAL_MR, SSE2_REAL_NR, Sse2RealKernel, Sse2Supported},
+    {"scalar", SCALAR_MR, SCALAR_NR, ScalarKernel, SCALAR_REAL_MR, SCALAR_REAL_NR, ScalarRealKernel, ScalarSupported},
+};
+
+#define KERNEL_COUNT (sizeof(kernels) / sizeof(kernels[0]))
+
+static const GemmKernel *selected_kernel = &kernels[KERNEL_COUNT - 1];
+
+const GemmKernel *CurrentGemmKernel(void) {
+    return selected_kernel;
+}
+
+static double SelfTestValue(unsigned *state) {
+    *state = *state * 1103515245u + 12345u;
+    return (double)(*state >> 8) / (1u << 24) * 2 - 1;
+}
+
+static int SameTile(const double *actual, const double *expected, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (fabs(actual[i] - expected[i]) > SELF_TEST_TOLERANCE * (1 + fabs(expected[i]))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Сравнивает оба ядра с эталонами на случайном тайле с ненулевыми начальными суммами.
+static int SelfTest(const GemmKernel *kernel) {
+    static double a[SELF_TEST_DEPTH * 2 * GEMM_MC];
+    static double b[SELF_TEST_DEPTH * 2 * GEMM_NC];
+    static double tile[2][2][GEMM_MC * GEMM_NC];
+    unsigned state = 1;
+
+    for (size_t i = 0; i < sizeof(a) / sizeof(a[0]); i++) {
+        a[i] = SelfTestValue(&state);
+    }
+    for (size_t i = 0; i < sizeof(b) / sizeof(b[0]); i++) {
+        b[i] = SelfTestValue(&state);
+    }
+    for (size_t i = 0; i < GEMM_MC * GEMM_NC; i++) {
+        tile[0][0][i] = tile[1][0][i] = SelfTestValue(&state);
+        tile[0][1][i] = tile[1][1][i] = SelfTestValue(&state);
+    }
+
+    kernel->run(SELF_TEST_DEPTH, a, b, tile[0][0], tile[0][1]);
+    ReferenceKernel(kernel->mr, kernel->nr, SELF_TEST_DEPTH, a, b, tile[1][0], tile[1][1]);
+    if (!SameTile(tile[0][0], tile[1][0], kernel->mr * GEMM_NC) || !SameTile(tile[0][1], tile[1][1], kernel->mr * GEMM_NC)) {
+        return 0;
+    }
+
+    // Вещественное ядро -- на тех же данных; начальные суммы -- результат проверки выше.
+    kernel->run_real(SELF_TEST_DEPTH, a, b, tile[0][0]);
+    ReferenceRealKernel(kernel->real_mr, kernel->real_nr, SELF_TEST_DEPTH, a, b, tile[1][0]);
+    return SameTile(tile[0][0], tile[1][0], kernel->real_mr * GEMM_NC);
+}
+
+void SelectGemmKernel(void) {
+    const char *forced = getenv("GEMM_KERNEL");
+
+    for (size_t i = 0; i < KERNEL_COUNT; i++) {
+        const GemmKernel *kernel = &kernels[i];
+        if (forced != NULL && strcmp(forced, kernel->name) != 0) {
+            continue;
+        }
+        if (!kernel->supported()) {
+            if (forced != NULL) {
+                HandleError("Ошибка: процессор не поддерживает ядро из GEMM_KERNEL.\n");
+            }
+            continue;
+        }
+        if (!SelfTest(kernel)) {
+            if (forced != NULL) {
+                HandleError("Ошибка: ядро из GEMM_KERNEL не прошло самопроверку.\n");
+            }
+            const char *msg = "Предупреждение: ядро не прошло самопроверку, используется следующее.\n";
+            write(STDERR_FILENO, msg, strlen(msg));
+            continue;
+        }
+        selected_kernel = kernel;
+        return;
+    }
+
+    if (forced != NULL) {
+        HandleError("Ошибка: неизвестное ядро в GEMM_KERNEL (avx512, avx2, sse2, scalar).\n");
+    }
+}
@@ -0,0 +1,24 @@
+#include <string.h>
+
+#include "driver.h"
+
+const char VARIANT_NAME[] = "lockfree";
+
+// Блоки результата не пересекаются, и каждый пишет ровно один поток, поэтому запись идёт без всякой
+// синхронизации; готовность всей матрицы главному потоку гарантирует pthread_join. Это базовая линия
+// для сравнения с mutex и atomic.
+
+void InitPublish(void) {
+}
+
+void FreePublish(void) {
+}
+
+void PublishBlock(Matrix *result, const Tile *tile, const GemmWorkspace *workspace) {
+    for (size_t i = 0; i < tile->rows; i++) {
+        memcpy(&MATRIX_RE(result, tile->row + i, tile->col), &workspace->tile_re[i * GEMM_NC],
+               tile->cols * sizeof(double));
+        memcpy(&MATRIX_IM(result, tile->row + i, tile->col), &workspace->tile_im[i * GEMM_NC],
+               tile->cols * sizeof(double));
+    }
+}
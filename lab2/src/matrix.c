@@ -0,0 +1,55 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "matrix.h"
+
+void AllocateMatrix(Matrix *matrix, size_t rows, size_t cols, MatrixLayout layout) {
+    size_t row_doubles = layout == MATRIX_SPLIT ? cols : 2 * cols;
+    size_t per_line = MATRIX_ALIGN / sizeof(double);
+    size_t stride = (row_doubles + per_line - 1) / per_line * per_line;
+    size_t plane = rows * stride;
+    void *memory = NULL;
+
+    // Обе плоскости -- в одном выделении; плоскость кратна строке кэша, поэтому im тоже выровнена.
+    if (posix_memalign(&memory, MATRIX_ALIGN, (layout == MATRIX_SPLIT ? 2 * plane : plane) * sizeof(double)) != 0) {
+        HandleError("Ошибка выделения памяти для матрицы.\n");
+    }
+
+    matrix->rows = rows;
+    matrix->cols = cols;
+    matrix->stride = stride;
+    matrix->re = memory;
+    matrix->mapping = NULL;
+    matrix->mapped = 0;
+    if (layout == MATRIX_SPLIT) {
+        matrix->step = 1;
+        matrix->im = matrix->re + plane;
+    } else {
+        matrix->step = 2;
+        matrix->im = matrix->re + 1;
+    }
+}
+
+void FreeMatrix(Matrix *matrix) {
+    if (matrix->mapped > 0) {
+        munmap(matrix->mapping, matrix->mapped);
+    } else {
+        free(matrix->re);
+    }
+}
+
+size_t MatrixBytes(const Matrix *matrix) {
+    size_t plane = matrix->rows * matrix->stride;
+    return (matrix->step == 1 ? 2 * plane : plane) * sizeof(double);
+}
+
+void TouchRows(Matrix *matrix, size_t first, size_t last) {
+    if (first >= last) {
+        return;
+    }
+    memset(matrix->re + first * matrix->stride, 0, (last - first) * matrix->stride * sizeof(double));
+    if (matrix->step == 1) {
+        memset(matrix->im + first * matrix->stride, 0, (last - first) * matrix->stride * sizeof(double));
+    }
+}
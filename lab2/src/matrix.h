@@ -0,0 +1,49 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <stddef.h>
+#include <complex.h>
+
+// Комплексная матрица одним выровненным блоком. Строки идут с шагом stride (в double), кратным
+// строке кэша, а элемент (i, j) лежит в re[i * stride + j * step] и im[i * stride + j * step].
+// MATRIX_SPLIT -- отдельные плоскости вещественных и мнимых частей (step = 1), по которым ядра идут
+// подряд векторами; MATRIX_INTERLEAVED -- привычные пары (re, im), как у double complex (step = 2).
+
+#define MATRIX_ALIGN 64
+
+typedef double complex cplx;
+
+typedef enum {
+    MATRIX_SPLIT,
+    MATRIX_INTERLEAVED
+} MatrixLayout;
+
+// mapping и mapped -- начало и длина отображения файла, из которого матрица загружена (storage.h);
+// у матриц из AllocateMatrix mapped = 0.
+typedef struct {
+    size_t rows;
+    size_t cols;
+    size_t stride;
+    size_t step;
+    double *re;
+    double *im;
+    void *mapping;
+    size_t mapped;
+} Matrix;
+
+#define MATRIX_RE(matrix, i, j) ((matrix)->re[(i) * (matrix)->stride + (j) * (matrix)->step])
+#define MATRIX_IM(matrix, i, j) ((matrix)->im[(i) * (matrix)->stride + (j) * (matrix)->step])
+
+void HandleError(const char *msg);
+
+void AllocateMatrix(Matrix *matrix, size_t rows, size_t cols, MatrixLayout layout);
+void FreeMatrix(Matrix *matrix);
+
+// Размер выделения матрицы в байтах.
+size_t MatrixBytes(const Matrix *matrix);
+
+// Обнуляет строки [first, last). Страница получает узел NUMA при первом касании, поэтому строки, которые
+// поток обнулил сам, оказываются в памяти его узла.
+void TouchRows(Matrix *matrix, size_t first, size_t last);
+
+#endif
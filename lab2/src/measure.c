@@ -0,0 +1,84 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#include "measure.h"
+
+static const uint64_t counter_configs[MEASURE_COUNTERS] = {
+    [MEASURE_CYCLES] = PERF_COUNT_HW_CPU_CYCLES,
+    [MEASURE_INSTRUCTIONS] = PERF_COUNT_HW_INSTRUCTIONS,
+    // Обобщённое событие промахов кэша ядро сопоставляет промахам LLC.
+    [MEASURE_LLC_MISSES] = PERF_COUNT_HW_CACHE_MISSES,
+};
+
+void InitMeasure(Measure *measure, int counters) {
+    for (int i = 0; i < MEASURE_COUNTERS; i++) {
+        measure->fds[i] = -1;
+        measure->counts[i] = -1;
+        if (!counters) {
+            continue;
+        }
+
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = counter_configs[i];
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        measure->fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    measure->seconds = 0;
+}
+
+void StartMeasure(Measure *measure) {
+    for (int i = 0; i < MEASURE_COUNTERS; i++) {
+        if (measure->fds[i] != -1) {
+            ioctl(measure->fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(measure->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &measure->start);
+}
+
+// Счётчики читаются после pthread_join: значения завершившихся потоков уже сложены в счётчик главного.
+void StopMeasure(Measure *measure) {
+    struct timespec finish;
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+    measure->seconds = (finish.tv_sec - measure->start.tv_sec) + (finish.tv_nsec - measure->start.tv_nsec) / 1e9;
+
+    for (int i = 0; i < MEASURE_COUNTERS; i++) {
+        uint64_t value;
+        if (measure->fds[i] == -1) {
+            continue;
+        }
+        ioctl(measure->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(measure->fds[i], &value, sizeof(value)) == sizeof(value)) {
+            measure->counts[i] = value;
+        }
+    }
+}
+
+void ReportMeasure(const Measure *measure, int fd) {
+    char buffer[128];
+    int length = snprintf(buffer, sizeof(buffer), "%.9f %lld %lld %lld\n", measure->seconds,
+                          measure->counts[MEASURE_CYCLES], measure->counts[MEASURE_INSTRUCTIONS],
+                          measure->counts[MEASURE_LLC_MISSES]);
+    if (write(fd, buffer, length) != length) {
+        HandleError("Ошибка записи отчёта о замере.\n");
+    }
+}
+
+void FreeMeasure(Measure *measure) {
+    for (int i = 0; i < MEASURE_COUNTERS; i++) {
+        if (measure->fds[i] != -1) {
+            close(measure->fds[i]);
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef MEASURE_H
+#define MEASURE_H
+
+#include <time.h>
+
+// Замер фазы умножения (от готовых входов до pthread_join всех потоков) для bench.
+// Счётчики perf_event_open -- такты, инструкции и промахи последнего уровня кэша, только в режиме
+// пользователя. Они открываются до создания потоков с inherit, поэтому считают и все рабочие потоки,
+// а включаются и выключаются вместе со временем. Недоступный счётчик (нет прав или PMU в виртуальной
+// машине) отчитывается как -1, остальное это не ломает.
+// Отчёт -- одна строка "секунды такты инструкции промахи" в заданный дескриптор.
+
+typedef enum {
+    MEASURE_CYCLES,
+    MEASURE_INSTRUCTIONS,
+    MEASURE_LLC_MISSES,
+    MEASURE_COUNTERS
+} MeasureCounter;
+
+typedef struct {
+    int fds[MEASURE_COUNTERS];
+    long long counts[MEASURE_COUNTERS];
+    struct timespec start;
+    double seconds;
+} Measure;
+
+void HandleError(const char *msg);
+
+// Вызывается до создания потоков; при counters = 0 замеряется только время.
+void InitMeasure(Measure *measure, int counters);
+void StartMeasure(Measure *measure);
+void StopMeasure(Measure *measure);
+void ReportMeasure(const Measure *measure, int fd);
+void FreeMeasure(Measure *measure);
+
+#endif
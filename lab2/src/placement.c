@@ -0,0 +1,160 @@
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "placement.h"
+
+#define PAGE_BATCH 1024
+
+// Узел ядра cpu: в /sys/devices/system/cpu/cpuN лежит ссылка nodeM. Без NUMA ссылки нет -- узел 0.
+static int CpuNode(int cpu) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return 0;
+    }
+
+    int node = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (sscanf(entry->d_name, "node%d", &node) == 1) {
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+void InitPlacement(Placement *placement, size_t workers) {
+    const char *pin = getenv("GEMM_PIN");
+
+    placement->workers = workers;
+    placement->cpu_count = 0;
+    placement->cpus = NULL;
+    if (pin == NULL || strcmp(pin, "0") == 0) {
+        placement->pinned = 0;
+    } else if (strcmp(pin, "1") == 0) {
+        placement->pinned = 1;
+    } else {
+        HandleError("Ошибка: GEMM_PIN должно быть 0 или 1.\n");
+    }
+
+    if (pthread_barrier_init(&placement->barrier, NULL, workers + 1) != 0) {
+        HandleError("Ошибка инициализации барьера.\n");
+    }
+    if (!placement->pinned) {
+        return;
+    }
+
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        HandleError("Ошибка получения списка доступных ядер.\n");
+    }
+
+    int *nodes = malloc(CPU_SETSIZE * sizeof(int));
+    placement->cpus = malloc(CPU_SETSIZE * sizeof(int));
+    if (nodes == NULL || placement->cpus == NULL) {
+        HandleError("Ошибка выделения памяти для списка ядер.\n");
+    }
+
+    // Ядра сортируются вставками по узлу; внутри узла остаётся порядок номеров.
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+        int node = CpuNode(cpu);
+        size_t pos = placement->cpu_count++;
+        while (pos > 0 && nodes[pos - 1] > node) {
+            nodes[pos] = nodes[pos - 1];
+            placement->cpus[pos] = placement->cpus[pos - 1];
+            pos--;
+        }
+        nodes[pos] = node;
+        placement->cpus[pos] = cpu;
+    }
+    free(nodes);
+}
+
+void FreePlacement(Placement *placement) {
+    pthread_barrier_destroy(&placement->barrier);
+    free(placement->cpus);
+}
+
+void PinWorker(const Placement *placement, size_t worker) {
+    if (!placement->pinned) {
+        return;
+    }
+
+    // Потоков больше, чем ядер, -- ядра раздаются по кругу.
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(placement->cpus[worker % placement->cpu_count], &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        HandleError("Ошибка закрепления потока за ядром.\n");
+    }
+}
+
+void PlacementWait(Placement *placement) {
+    int status = pthread_barrier_wait(&placement->barrier);
+    if (status != 0 && status != PTHREAD_BARRIER_SERIAL_THREAD) {
+        HandleError("Ошибка ожидания на барьере.\n");
+    }
+}
+
+void ReportMemoryNodes(const char *name, const void *memory, size_t bytes) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t first = (uintptr_t)memory / page_size * page_size;
+    size_t page_count = ((uintptr_t)memory + bytes - first + page_size - 1) / page_size;
+    size_t per_node[PLACEMENT_MAX_NODES] = {0};
+    size_t unplaced = 0;
+    void *pages[PAGE_BATCH];
+    int status[PAGE_BATCH];
+    char buffer[1024];
+    int length;
+
+    // move_pages без целевых узлов ничего не переносит, а только сообщает узел каждой страницы.
+    for (size_t done = 0; done < page_count; done += PAGE_BATCH) {
+        size_t batch = page_count - done < PAGE_BATCH ? page_count - done : PAGE_BATCH;
+        for (size_t i = 0; i < batch; i++) {
+            pages[i] = (void *)(first + (done + i) * page_size);
+        }
+        if (syscall(SYS_move_pages, 0, batch, pages, NULL, status, 0) != 0) {
+            length = snprintf(buffer, sizeof(buffer), "Узлы NUMA для %s: move_pages недоступен\n", name);
+            write(STDERR_FILENO, buffer, length);
+            return;
+        }
+        for (size_t i = 0; i < batch; i++) {
+            if (status[i] >= 0 && status[i] < PLACEMENT_MAX_NODES) {
+                per_node[status[i]]++;
+            } else {
+                unplaced++;
+            }
+        }
+    }
+
+    length = snprintf(buffer, sizeof(buffer), "Узлы NUMA для %s (%.1f МиБ):", name, bytes / 1048576.0);
+    for (int node = 0; node < PLACEMENT_MAX_NODES; node++) {
+        if (per_node[node] > 0 && length < (int)sizeof(buffer)) {
+            length += snprintf(buffer + length, sizeof(buffer) - length, " узел %d -- %.1f%%", node,
+                               100.0 * per_node[node] / page_count);
+        }
+    }
+    if (unplaced > 0 && length < (int)sizeof(buffer)) {
+        length += snprintf(buffer + length, sizeof(buffer) - length, " не размещено -- %.1f%%",
+                           100.0 * unplaced / page_count);
+    }
+    if (length >= (int)sizeof(buffer) - 1) {
+        length = sizeof(buffer) - 2;
+    }
+    buffer[length++] = '\n';
+    write(STDERR_FILENO, buffer, length);
+}
@@ -0,0 +1,36 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+// Размещение потоков и данных на машинах с несколькими узлами NUMA.
+// Страница попадает на узел того потока, который первым её коснулся, поэтому каждый поток сам обнуляет
+// свои строки матриц (WorkerRows) и пакует свою долю панелей matrix2, а главный поток заполняет матрицы
+// значениями уже после этого. Чтобы поток не увели на другой узел, при GEMM_PIN=1 поток i закрепляется
+// за i-м доступным ядром; ядра упорядочены по узлам, так что соседние потоки (и соседние строки) живут
+// на одном узле. В этом режиме после умножения в stderr печатается, на каких узлах лежат матрицы.
+
+#define PLACEMENT_MAX_NODES 64
+
+typedef struct {
+    size_t workers;
+    int pinned;
+    size_t cpu_count;
+    int *cpus;
+    pthread_barrier_t barrier;
+} Placement;
+
+void HandleError(const char *msg);
+
+// Барьер рассчитан на workers потоков и главный поток.
+void InitPlacement(Placement *placement, size_t workers);
+void FreePlacement(Placement *placement);
+
+void PinWorker(const Placement *placement, size_t worker);
+void PlacementWait(Placement *placement);
+
+// Печатает, какая доля страниц [memory, memory + bytes) лежит на каждом узле.
+void ReportMemoryNodes(const char *name, const void *memory, size_t bytes);
+
+#endif
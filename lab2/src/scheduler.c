@@ -0,0 +1,123 @@
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "gemm.h"
+#include "scheduler.h"
+
+#define RANGE(begin, end) ((uint64_t)(end) << 32 | (uint32_t)(begin))
+#define RANGE_BEGIN(range) ((uint32_t)(range))
+#define RANGE_END(range) ((uint32_t)((range) >> 32))
+
+size_t DefaultWorkerCount(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (size_t)count : 1;
+}
+
+void InitScheduler(TileScheduler *scheduler, size_t size, size_t workers) {
+    size_t row_tiles = (size + GEMM_MC - 1) / GEMM_MC;
+    size_t col_tiles = (size + GEMM_NC - 1) / GEMM_NC;
+    size_t tiles = row_tiles * col_tiles;
+    void *memory = NULL;
+
+    if (tiles > UINT32_MAX) {
+        HandleError("Ошибка: слишком большая матрица.\n");
+    }
+    if (posix_memalign(&memory, SCHEDULER_CACHE_LINE, workers * sizeof(TileDeque)) != 0) {
+        HandleError("Ошибка выделения памяти для очередей потоков.\n");
+    }
+
+    scheduler->size = size;
+    scheduler->col_tiles = col_tiles;
+    scheduler->workers = workers;
+    scheduler->deques = memory;
+
+    // Начальная раздача -- поровну подряд идущими диапазонами, дальше баланс держит перехват.
+    for (size_t w = 0; w < workers; w++) {
+        atomic_init(&scheduler->deques[w].range, RANGE(tiles * w / workers, tiles * (w + 1) / workers));
+    }
+}
+
+void FreeScheduler(TileScheduler *scheduler) {
+    free(scheduler->deques);
+}
+
+void WorkerRows(const TileScheduler *scheduler, size_t worker, size_t *first, size_t *last) {
+    size_t col_tiles = scheduler->col_tiles;
+    // У пустой матрицы нет ни одного блока, и делить на col_tiles нельзя.
+    if (col_tiles == 0) {
+        *first = *last = 0;
+        return;
+    }
+    size_t tiles = (scheduler->size + GEMM_MC - 1) / GEMM_MC * col_tiles;
+    size_t begin = tiles * worker / scheduler->workers;
+    size_t end = tiles * (worker + 1) / scheduler->workers;
+    size_t first_row = (begin + col_tiles - 1) / col_tiles * GEMM_MC;
+    size_t last_row = (end + col_tiles - 1) / col_tiles * GEMM_MC;
+
+    *first = first_row < scheduler->size ? first_row : scheduler->size;
+    *last = last_row < scheduler->size ? last_row : scheduler->size;
+}
+
+static void DescribeTile(const TileScheduler *scheduler, uint32_t index, Tile *tile) {
+    size_t size = scheduler->size;
+
+    tile->row = index / scheduler->col_tiles * GEMM_MC;
+    tile->col = index % scheduler->col_tiles * GEMM_NC;
+    tile->rows = size - tile->row < GEMM_MC ? size - tile->row : GEMM_MC;
+    tile->cols = size - tile->col < GEMM_NC ? size - tile->col : GEMM_NC;
+}
+
+static int PopTile(TileDeque *deque, uint32_t *index) {
+    uint64_t range = atomic_load_explicit(&deque->range, memory_order_acquire);
+
+    while (RANGE_BEGIN(range) < RANGE_END(range)) {
+        uint64_t taken = RANGE(RANGE_BEGIN(range) + 1, RANGE_END(range));
+        if (atomic_compare_exchange_weak_explicit(&deque->range, &range, taken, memory_order_acq_rel,
+                                                  memory_order_acquire)) {
+            *index = RANGE_BEGIN(range);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Отрезает у victim вторую половину оставшихся блоков (при одном блоке -- его).
+static int StealTiles(TileDeque *victim, uint32_t *begin, uint32_t *end) {
+    uint64_t range = atomic_load_explicit(&victim->range, memory_order_acquire);
+
+    while (RANGE_BEGIN(range) < RANGE_END(range)) {
+        uint32_t left = RANGE_END(range) - RANGE_BEGIN(range);
+        uint32_t split = RANGE_END(range) - (left + 1) / 2;
+        if (atomic_compare_exchange_weak_explicit(&victim->range, &range, RANGE(RANGE_BEGIN(range), split),
+                                                  memory_order_acq_rel, memory_order_acquire)) {
+            *begin = split;
+            *end = RANGE_END(range);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int NextTile(TileScheduler *scheduler, size_t worker, Tile *tile) {
+    TileDeque *own = &scheduler->deques[worker];
+    uint32_t index;
+
+    if (PopTile(own, &index)) {
+        DescribeTile(scheduler, index, tile);
+        return 1;
+    }
+
+    // Жертвы перебираются по кругу, начиная с соседа, чтобы воры не набрасывались на один поток.
+    for (size_t step = 1; step < scheduler->workers; step++) {
+        size_t victim = (worker + step) % scheduler->workers;
+        uint32_t begin, end;
+
+        if (StealTiles(&scheduler->deques[victim], &begin, &end)) {
+            // Своя очередь пуста, и воры её не меняют -- диапазон можно просто записать.
+            atomic_store_explicit(&own->range, RANGE(begin + 1, end), memory_order_release);
+            DescribeTile(scheduler, begin, tile);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Раздача блоков результата (GEMM_MC x GEMM_NC) между потоками с перехватом работы.
+// Блоки пронумерованы построчно; у каждого потока своя очередь -- непрерывный диапазон номеров
+// [begin, end), упакованный в одно 64-битное слово, так что и владелец, и вор меняют его одним CAS.
+// Владелец берёт блоки с начала диапазона (соседние блоки делят строки matrix1), а опустевший поток
+// отрезает у другого вторую половину оставшегося и дальше работает с ней как со своей.
+// Новых блоков не появляется, поэтому поток, не нашедший работы ни в одной очереди, завершается.
+
+#define SCHEDULER_CACHE_LINE 64
+
+typedef struct {
+    _Alignas(SCHEDULER_CACHE_LINE) _Atomic uint64_t range;
+} TileDeque;
+
+typedef struct {
+    size_t size;
+    size_t col_tiles;
+    size_t workers;
+    TileDeque *deques;
+} TileScheduler;
+
+typedef struct {
+    size_t row;
+    size_t rows;
+    size_t col;
+    size_t cols;
+} Tile;
+
+void HandleError(const char *msg);
+
+// Число потоков по умолчанию -- число доступных процессору ядер.
+size_t DefaultWorkerCount(void);
+
+void InitScheduler(TileScheduler *scheduler, size_t size, size_t workers);
+void FreeScheduler(TileScheduler *scheduler);
+
+// Строки [first, last), которые поток worker размещает у себя: блоки строк, первый блок которых попал в его
+// начальный диапазон. Диапазоны разных потоков не пересекаются и вместе покрывают всю матрицу.
+void WorkerRows(const TileScheduler *scheduler, size_t worker, size_t *first, size_t *last);
+
+// Выдаёт потоку worker следующий блок; 0, когда блоков не осталось.
+int NextTile(TileScheduler *scheduler, size_t worker, Tile *tile);
+
+#endif
@@ -0,0 +1,166 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "storage.h"
+
+#define TEXT_BUFFER_SIZE (1 << 16)
+// Самый длинный элемент: два %.2f от -DBL_MAX по 313 символов и обрамление.
+#define TEXT_ELEMENT_MAX 640
+
+static void WriteAll(int fd, const void *data, size_t length) {
+    const char *cursor = data;
+
+    while (length > 0) {
+        ssize_t written = write(fd, cursor, length);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            HandleError("Ошибка записи матрицы.\n");
+        }
+        cursor += written;
+        length -= written;
+    }
+}
+
+void LoadMatrix(Matrix *matrix, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        HandleError("Ошибка открытия файла матрицы.\n");
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == -1) {
+        HandleError("Ошибка получения размера файла матрицы.\n");
+    }
+    size_t size = info.st_size;
+    if (size < sizeof(MatrixFileHeader)) {
+        HandleError("Ошибка: файл слишком мал для матрицы.\n");
+    }
+
+    void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        HandleError("Ошибка отображения файла матрицы.\n");
+    }
+    close(fd);
+
+    const MatrixFileHeader *header = mapping;
+    if (memcmp(header->magic, MATRIX_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != MATRIX_FILE_VERSION) {
+        HandleError("Ошибка: файл не является матрицей lab2.\n");
+    }
+    if (header->dtype != MATRIX_DTYPE_COMPLEX_DOUBLE ||
+        (header->layout != MATRIX_SPLIT && header->layout != MATRIX_INTERLEAVED)) {
+        HandleError("Ошибка: неподдерживаемый тип элементов или раскладка матрицы.\n");
+    }
+
+    // Размер данных проверяется делением, чтобы испорченный заголовок не переполнил произведение.
+    size_t planes = header->layout == MATRIX_SPLIT ? 2 : 1;
+    size_t step = header->layout == MATRIX_SPLIT ? 1 : 2;
+    size_t data_doubles = (size - sizeof(MatrixFileHeader)) / sizeof(double);
+    if (header->cols > header->stride / step ||
+        (header->rows > 0 && header->stride > data_doubles / planes / header->rows) ||
+        sizeof(MatrixFileHeader) + planes * header->rows * header->stride * sizeof(double) != size) {
+        HandleError("Ошибка: размеры в заголовке не совпадают с размером файла матрицы.\n");
+    }
+
+    madvise(mapping, size, MADV_WILLNEED);
+
+    matrix->rows = header->rows;
+    matrix->cols = header->cols;
+    matrix->stride = header->stride;
+    matrix->step = step;
+    matrix->re = (double *)((char *)mapping + sizeof(MatrixFileHeader));
+    matrix->im = header->layout == MATRIX_SPLIT ? matrix->re + matrix->rows * matrix->stride : matrix->re + 1;
+    matrix->mapping = mapping;
+    matrix->mapped = size;
+}
+
+void SaveMatrix(const Matrix *matrix, const char *path) {
+    MatrixFileHeader header = {0};
+
+    memcpy(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic));
+    header.version = MATRIX_FILE_VERSION;
+    header.dtype = MATRIX_DTYPE_COMPLEX_DOUBLE;
+    header.layout = matrix->step == 1 ? MATRIX_SPLIT : MATRIX_INTERLEAVED;
+    header.rows = matrix->rows;
+    header.cols = matrix->cols;
+    header.stride = matrix->stride;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        HandleError("Ошибка создания файла матрицы.\n");
+    }
+    WriteAll(fd, &header, sizeof(header));
+    WriteAll(fd, matrix->re, MatrixBytes(matrix));
+    if (close(fd) == -1) {
+        HandleError("Ошибка записи матрицы.\n");
+    }
+}
+
+// Целые значения (а при целых входах других в результате не бывает) печатаются без snprintf,
+// по две цифры за шаг; остальные -- через snprintf, чтобы округление совпадало с %.2f в точности.
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static char *AppendFixed(char *out, const char *limit, double value) {
+    if (value != trunc(value) || fabs(value) >= 1e15) {
+        return out + snprintf(out, limit - out, "%.2f", value);
+    }
+
+    char digits[24];
+    char *cursor = digits + sizeof(digits);
+    unsigned long long magnitude = (unsigned long long)fabs(value);
+
+    while (magnitude >= 100) {
+        cursor -= 2;
+        memcpy(cursor, digit_pairs + magnitude % 100 * 2, 2);
+        magnitude /= 100;
+    }
+    if (magnitude >= 10) {
+        cursor -= 2;
+        memcpy(cursor, digit_pairs + magnitude * 2, 2);
+    } else {
+        *--cursor = '0' + magnitude;
+    }
+    // Как и printf, -0.0 печатается со знаком.
+    if (signbit(value)) {
+        *--cursor = '-';
+    }
+
+    size_t length = digits + sizeof(digits) - cursor;
+    memcpy(out, cursor, length);
+    memcpy(out + length, ".00", 3);
+    return out + length + 3;
+}
+
+void WriteMatrixText(int fd, const Matrix *matrix) {
+    static char buffer[TEXT_BUFFER_SIZE];
+    const char *limit = buffer + sizeof(buffer);
+    char *out = buffer;
+
+    for (size_t i = 0; i < matrix->rows; i++) {
+        for (size_t j = 0; j < matrix->cols; j++) {
+            if (limit - out < TEXT_ELEMENT_MAX) {
+                WriteAll(fd, buffer, out - buffer);
+                out = buffer;
+            }
+            *out++ = '(';
+            out = AppendFixed(out, limit, MATRIX_RE(matrix, i, j));
+            memcpy(out, " + ", 3);
+            out = AppendFixed(out + 3, limit, MATRIX_IM(matrix, i, j));
+            memcpy(out, "i) ", 3);
+            out += 3;
+        }
+        *out++ = '\n';
+    }
+    WriteAll(fd, buffer, out - buffer);
+}
@@ -0,0 +1,40 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <stdint.h>
+
+#include "matrix.h"
+
+// Двоичный формат матрицы: заголовок MatrixFileHeader и сразу за ним память матрицы ровно в том виде,
+// в каком её держит Matrix (строки с шагом stride, для MATRIX_SPLIT -- плоскость re, затем im).
+// Поэтому загрузка -- это mmap файла без разбора, а сохранение -- заголовок и одна большая запись.
+// Порядок байт -- родной (x86-64, little-endian). Заголовок занимает MATRIX_ALIGN байт, так что данные
+// в отображении выровнены так же, как у AllocateMatrix.
+
+#define MATRIX_FILE_MAGIC "LAB2MTX"
+#define MATRIX_FILE_VERSION 1
+// Единственный тип элементов -- комплексное число из двух double.
+#define MATRIX_DTYPE_COMPLEX_DOUBLE 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;
+    uint32_t layout;
+    uint32_t reserved;
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t stride;
+    uint8_t padding[16];
+} MatrixFileHeader;
+
+_Static_assert(sizeof(MatrixFileHeader) == MATRIX_ALIGN, "заголовок должен занимать MATRIX_ALIGN байт");
+
+// Отображает файл в память только для чтения; освобождается обычным FreeMatrix.
+void LoadMatrix(Matrix *matrix, const char *path);
+void SaveMatrix(const Matrix *matrix, const char *path);
+
+// Печатает матрицу построчно в формате "(%.2f + %.2fi) " через буфер, сбрасываемый большими кусками.
+void WriteMatrixText(int fd, const Matrix *matrix);
+
+#endif
@@ -1,116 +1,1019 @@
+#define _GNU_SOURCE
 #include <unistd.h>
 #include <stdio.h>
 #include <limits.h>
+#include <stdint.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <fcntl.h>
-#include <semaphore.h>
+#include <signal.h>
+#include <sys/prctl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include "shared.h"
 
-#define SHM_NAME "/shared_memory"
-#define SEM_NAME "/sync_semaphore"
-#define BUFFER_SIZE 1024
-#define NUM_LINES 100
+#define READ_CHUNK_SIZE (1 << 20)
+#define CACHE_SLOT_SIZE 256
+#define CACHE_WAYS 4
+#define CACHE_MAX_KEY 128
+#define PIPE_CHUNK_SIZE (256 * 1024)
+#define PIPE_CHUNKS_PER_THREAD 2
+#define MAX_PARSER_THREADS 64
+
+SharedRing *ring;
+JobQueue *queue;
+uint32_t ring_head = 0;
+uint32_t cached_tail = 0;
+// Счётчики выборки для замеров (make STATS=1).
+unsigned publish_samples = 0;
+int first_publish = 1;
+_Thread_local unsigned parse_samples = 0;
 
 void HandleError(const char *message) {
     write(STDERR_FILENO, message, strlen(message));
     exit(EXIT_FAILURE);
 }
 
-int safe_strtol(const char *str, char **endptr) {
-    long value = strtol(str, endptr, 10);
-    if (value > INT_MAX || value < INT_MIN) {
-        HandleError("Ошибка: значение выходит за пределы диапазона int.\n");
+// Ждёт, пока в кольце освободится не меньше size байт.
+// tail читается из чужой кэш-линии только тогда, когда по сохранённому значению места нет.
+void RingWaitFree(uint32_t size) {
+    while (ring->capacity - (ring_head - cached_tail) < size) {
+        cached_tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (ring->capacity - (ring_head - cached_tail) < size) {
+            STAT_DECLARE(wait_start);
+            STAT_START(wait_start);
+            RingWait(ring->spin_limit, &ring->tail, cached_tail, &ring->producer_waiting, NULL);
+            STAT_STOP(ring, STAT_PRODUCER_WAIT, wait_start);
+        }
     }
-    return (int)value;
 }
 
-int main() {
-    int shm_fd;
-    char *shared_mem;
-    sem_t *semaphore;
+// Возвращает место под текст записи длиной до BUFFER_SIZE байт прямо в кольце.
+// Если до конца данных не хватает места, остаток закрывается записью RECORD_WRAP.
+char *RingReserve(void) {
+    uint32_t offset = ring_head & (ring->capacity - 1);
+    uint32_t room = ring->capacity - offset;
 
-    shm_fd = shm_open(SHM_NAME, O_RDWR, 0666);
-    if (shm_fd == -1) {
-        HandleError("Ошибка подключения к разделяемой памяти.\n");
+    if (room < RECORD_SIZE(BUFFER_SIZE)) {
+        RingWaitFree(room);
+        *(uint32_t *)(ring->data + offset) = RECORD_WRAP;
+        ring_head += room;
+        offset = 0;
     }
+    RingWaitFree(RECORD_SIZE(BUFFER_SIZE));
+    return ring->data + offset + sizeof(uint32_t);
+}
 
-    shared_mem = mmap(NULL, BUFFER_SIZE * NUM_LINES, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-    if (shared_mem == MAP_FAILED) {
-        HandleError("Ошибка отображения разделяемой памяти.\n");
+// Делает видимым всё записанное до ring_head: parent увидит данные не раньше нового head.
+// records -- число записей в публикации, по нему идёт выборка замеров передачи.
+void RingPublish(uint32_t records) {
+    STAT_STAMP_HANDOFF(ring, ring_head, publish_samples, records, first_publish);
+    first_publish = 0;
+    __atomic_store_n(&ring->head, ring_head, __ATOMIC_RELEASE);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->consumer_waiting, __ATOMIC_RELAXED)
+        && (int32_t)(ring_head - __atomic_load_n(&ring->consumer_wake_at, __ATOMIC_RELAXED)) >= 0) {
+        FutexWake(&ring->head);
     }
+}
+
+// Публикует запись, полученную RingReserve.
+void RingCommit(size_t length) {
+    *(uint32_t *)(ring->data + (ring_head & (ring->capacity - 1))) = length;
+    ring_head += RECORD_SIZE(length);
+    RingPublish(1);
+}
 
-    semaphore = sem_open(SEM_NAME, 0);
-    if (semaphore == SEM_FAILED) {
-        HandleError("Ошибка подключения к семафору.\n");
+// Копирует в кольцо готовые записи [длина][текст] подряд, большими кусками вместо записи по одной.
+void RingWriteRecords(const char *records, size_t size) {
+    const char *current = records;
+    const char *end = records + size;
+    STAT_DECLARE(write_start);
+    STAT_START(write_start);
+
+    while (current < end) {
+        uint32_t offset = ring_head & (ring->capacity - 1);
+        uint32_t room = ring->capacity - offset;
+
+        // Кусок -- целые записи до конца данных кольца, но не больше четверти кольца, чтобы parent
+        // начинал печать, не дожидаясь, пока освободится почти всё кольцо.
+        size_t run = 0;
+        uint32_t count = 0;
+        while (current + run < end) {
+            uint32_t record = RECORD_SIZE(*(const uint32_t *)(current + run));
+            if (run + record > room || run + record > ring->capacity / 4) {
+                break;
+            }
+            run += record;
+            count++;
+        }
+
+        if (run == 0) {
+            RingWaitFree(room);
+            *(uint32_t *)(ring->data + offset) = RECORD_WRAP;
+            ring_head += room;
+            continue;
+        }
+
+        RingWaitFree(run);
+        memcpy(ring->data + offset, current, run);
+        current += run;
+        ring_head += run;
+        RingPublish(count);
     }
+    STAT_STOP(ring, STAT_RING_WRITE, write_start);
+}
 
-    sem_wait(semaphore);
+void RingPushMessage(const char *message) {
+    size_t length = strlen(message);
+    memcpy(RingReserve(), message, length);
+    RingCommit(length);
+}
 
-    char filename[BUFFER_SIZE];
-    strncpy(filename, shared_mem, BUFFER_SIZE);
+// Закрывает результаты файла записью RECORD_END; parent ждёт её и потому будится без порога.
+void RingEndJob(void) {
+    RingWaitFree(RECORD_SIZE(0));
+    *(uint32_t *)(ring->data + (ring_head & (ring->capacity - 1))) = RECORD_END;
+    ring_head += RECORD_SIZE(0);
+    __atomic_store_n(&ring->head, ring_head, __ATOMIC_RELEASE);
+    RingNotify(&ring->head, &ring->consumer_waiting);
+    first_publish = 1;
+}
 
-    int file = open(filename, O_RDONLY);
-    if (file == -1) {
-        strncpy(shared_mem, "Ошибка: Не удалось открыть файл.\n", BUFFER_SIZE);
-        sem_post(semaphore);
-        exit(EXIT_FAILURE);
+// Разбор числа в границах [*cursor, end): данные из mmap не завершаются нулём, поэтому strtol не подходит.
+// Как и strtol, при отсутствии цифр кладёт в *number 0 и не сдвигает курсор.
+// Возвращает -1, если значение выходит за пределы int.
+int ParseInt(const char **cursor, const char *end, int *number) {
+    const char *current = *cursor;
+    int negative = 0;
+
+    if (current < end && (*current == '-' || *current == '+')) {
+        negative = (*current == '-');
+        current++;
+    }
+
+    const char *digits = current;
+    unsigned long long value = 0;
+    while (current < end && (unsigned char)(*current - '0') < 10) {
+        if (value <= (unsigned long long)INT_MAX + 1) {
+            value = value * 10 + (unsigned char)(*current - '0');
+        }
+        current++;
+    }
+
+    if (current == digits) {
+        *number = 0;
+        return 0;
+    }
+
+    if (value > (unsigned long long)INT_MAX + negative) {
+        return -1;
+    }
+
+    *cursor = current;
+    *number = (int)(negative ? -(long long)value : (long long)value);
+    return 0;
+}
+
+// Быстрое форматирование результата вместо snprintf: литералы копируются целиком, числа -- по две цифры
+// за шаг. Всё, что не помещается до limit, отбрасывается, как при усечении у snprintf.
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+char *AppendText(char *out, const char *limit, const char *text, size_t len) {
+    if (len > (size_t)(limit - out)) {
+        len = limit - out;
+    }
+    memcpy(out, text, len);
+    return out + len;
+}
+
+char *AppendInt(char *out, const char *limit, int value) {
+    char digits[12];
+    char *cursor = digits + sizeof(digits);
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+
+    while (magnitude >= 100) {
+        unsigned int pair = (magnitude % 100) * 2;
+        magnitude /= 100;
+        cursor -= 2;
+        memcpy(cursor, digit_pairs + pair, 2);
+    }
+    if (magnitude >= 10) {
+        cursor -= 2;
+        memcpy(cursor, digit_pairs + magnitude * 2, 2);
+    } else {
+        *--cursor = '0' + magnitude;
+    }
+    if (value < 0) {
+        *--cursor = '-';
+    }
+
+    return AppendText(out, limit, cursor, digits + sizeof(digits) - cursor);
+}
+
+// Кэш готовых результатов для повторяющихся строк (-c БАЙТ). Ключ -- строка с токенами через один
+// пробел; одинаковый ключ даёт одинаковый результат. Наборы по CACHE_WAYS слотов, вытесняется самый давний.
+typedef struct {
+    uint64_t hash;
+    uint32_t stamp;
+    uint16_t key_len;
+    uint16_t value_len;
+    char data[CACHE_SLOT_SIZE - 16];
+} CacheSlot;
+
+typedef struct {
+    CacheSlot *slots;
+    size_t set_mask;
+    uint32_t clock;
+    unsigned long long lookups;
+    unsigned long long hits;
+    unsigned long long stores;
+    unsigned long long evictions;
+} LineCache;
+
+// У каждого потока разбора свой кэш; при завершении потока счётчики складываются в cache_totals.
+// Потоки разбора живут до конца работы child, так что в пуле кэш переживает смену файлов.
+_Thread_local LineCache line_cache;
+size_t cache_budget = 0;
+size_t cache_slot_count = 0;
+LineCache cache_totals;
+pthread_mutex_t cache_totals_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void MergeCacheStats(void) {
+    pthread_mutex_lock(&cache_totals_mutex);
+    cache_totals.lookups += line_cache.lookups;
+    cache_totals.hits += line_cache.hits;
+    cache_totals.stores += line_cache.stores;
+    cache_totals.evictions += line_cache.evictions;
+    if (line_cache.slots != NULL) {
+        cache_slot_count += (line_cache.set_mask + 1) * CACHE_WAYS;
+    }
+    pthread_mutex_unlock(&cache_totals_mutex);
+    free(line_cache.slots);
+    memset(&line_cache, 0, sizeof(line_cache));
+}
+
+void ReportCacheStats(void) {
+    MergeCacheStats();
+
+    char report[BUFFER_SIZE];
+    int report_len = snprintf(report, sizeof(report),
+                              "[CACHE] Обращений: %llu, попаданий: %llu (%.1f%%), записей: %llu, вытеснений: %llu, слотов: %zu\n",
+                              cache_totals.lookups, cache_totals.hits,
+                              cache_totals.lookups ? 100.0 * cache_totals.hits / cache_totals.lookups : 0.0,
+                              cache_totals.stores, cache_totals.evictions, cache_slot_count);
+    write(STDERR_FILENO, report, report_len);
+}
+
+void InitCache(size_t budget) {
+    size_t sets = budget / (sizeof(CacheSlot) * CACHE_WAYS);
+    if (sets == 0) {
+        HandleError("Ошибка: бюджет кэша меньше одного набора слотов.\n");
+    }
+
+    size_t set_count = 1;
+    while (set_count * 2 <= sets) {
+        set_count *= 2;
+    }
+
+    line_cache.slots = calloc(set_count * CACHE_WAYS, sizeof(CacheSlot));
+    if (line_cache.slots == NULL) {
+        HandleError("Ошибка выделения памяти для кэша.\n");
+    }
+    line_cache.set_mask = set_count - 1;
+}
+
+// Строит нормализованный ключ и его хэш (FNV-1a). Возвращает 0, если ключ длиннее CACHE_MAX_KEY.
+int NormalizeLine(const char *current, const char *end, char *key, size_t *key_len, uint64_t *hash) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    size_t len = 0;
+    int separator = 0;
+
+    for (; current < end; current++) {
+        unsigned char c = *current;
+        if (c == ' ' || c == '\t') {
+            separator = 1;
+            continue;
+        }
+        if (len + separator >= CACHE_MAX_KEY) {
+            return 0;
+        }
+        if (separator) {
+            key[len++] = ' ';
+            h = (h ^ ' ') * 0x100000001b3ULL;
+            separator = 0;
+        }
+        key[len++] = c;
+        h = (h ^ c) * 0x100000001b3ULL;
+    }
+
+    *key_len = len;
+    *hash = h;
+    return 1;
+}
+
+CacheSlot *CacheLookup(uint64_t hash, const char *key, size_t key_len) {
+    CacheSlot *set = &line_cache.slots[(hash & line_cache.set_mask) * CACHE_WAYS];
+
+    line_cache.lookups++;
+    for (int way = 0; way < CACHE_WAYS; way++) {
+        CacheSlot *slot = &set[way];
+        if (slot->key_len == key_len && slot->hash == hash && memcmp(slot->data, key, key_len) == 0) {
+            slot->stamp = ++line_cache.clock;
+            line_cache.hits++;
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+void CacheStore(uint64_t hash, const char *key, size_t key_len, const char *value, size_t value_len) {
+    if (key_len + value_len > sizeof(((CacheSlot *)0)->data)) {
+        return;
+    }
+
+    CacheSlot *set = &line_cache.slots[(hash & line_cache.set_mask) * CACHE_WAYS];
+    CacheSlot *victim = &set[0];
+    for (int way = 0; way < CACHE_WAYS; way++) {
+        if (set[way].key_len == 0) {
+            victim = &set[way];
+            break;
+        }
+        if (set[way].stamp < victim->stamp) {
+            victim = &set[way];
+        }
+    }
+
+    if (victim->key_len != 0) {
+        line_cache.evictions++;
+    }
+    victim->hash = hash;
+    victim->stamp = ++line_cache.clock;
+    victim->key_len = key_len;
+    victim->value_len = value_len;
+    memcpy(victim->data, key, key_len);
+    memcpy(victim->data + key_len, value, value_len);
+    line_cache.stores++;
+}
+
+// Кладёт в result сообщение об ошибке строки и поднимает *failed.
+size_t FailLine(char *result, const char *message, int *failed) {
+    *failed = 1;
+    memcpy(result, message, strlen(message));
+    return strlen(message);
+}
+
+// Форматирует результат строки [current, end) без завершающего '\n' в result (BUFFER_SIZE байт) и
+// возвращает его длину; 0 -- пустая строка. При делении на ноль или числе вне диапазона int в result
+// кладётся сообщение об ошибке и поднимается *failed: разбор файла на этом заканчивается.
+size_t FormatLine(const char *current, const char *end, char *result, int *failed) {
+    while (current < end && (*current == ' ' || *current == '\t')) current++;
+    if (current == end) {
+        return 0;
+    }
+
+    char key[CACHE_MAX_KEY];
+    size_t key_len;
+    uint64_t hash;
+    int cacheable = 0;
+
+    if (line_cache.slots != NULL && NormalizeLine(current, end, key, &key_len, &hash)) {
+        CacheSlot *cached = CacheLookup(hash, key, key_len);
+        if (cached != NULL) {
+            memcpy(result, cached->data + cached->key_len, cached->value_len);
+            return cached->value_len;
+        }
+        cacheable = 1;
+    }
+
+    int first_number;
+    if (ParseInt(&current, end, &first_number) == -1) {
+        return FailLine(result, "Ошибка: значение выходит за пределы диапазона int.\n", failed);
+    }
+
+    const char *limit = result + BUFFER_SIZE - 2;
+    char *cursor = AppendText(result, limit, "Результат: ", sizeof("Результат: ") - 1);
+    cursor = AppendInt(cursor, limit, first_number);
+
+    while (current < end) {
+        while (current < end && (*current == ' ' || *current == '\t')) current++;
+        if (current == end) break;
+
+        int next_number;
+        if (ParseInt(&current, end, &next_number) == -1) {
+            return FailLine(result, "Ошибка: значение выходит за пределы диапазона int.\n", failed);
+        }
+        if (next_number == 0) {
+            return FailLine(result, "Ошибка: Деление на ноль.\n", failed);
+        }
+
+        if (cursor < limit) {
+            cursor = AppendText(cursor, limit, ", ", 2);
+            cursor = AppendInt(cursor, limit, first_number);
+            cursor = AppendText(cursor, limit, " / ", 3);
+            cursor = AppendInt(cursor, limit, next_number);
+            cursor = AppendText(cursor, limit, " = ", 3);
+            cursor = AppendInt(cursor, limit, first_number / next_number);
+        }
+    }
+
+    *cursor++ = '\n';
+    size_t result_len = cursor - result;
+    if (cacheable) {
+        CacheStore(hash, key, key_len, result, result_len);
+    }
+    return result_len;
+}
+
+// Обрабатывает одну строку и сразу публикует результат в кольце.
+// Возвращает -1, если разбор файла надо прекратить (сообщение об ошибке уже в кольце).
+int ProcessLine(const char *current, const char *end) {
+    int failed = 0;
+    char *result = RingReserve();
+    STAT_DECLARE(parse_start);
+    int sampled = STAT_SAMPLED(parse_samples);
+    if (sampled) {
+        STAT_START(parse_start);
+    }
+    size_t length = FormatLine(current, end, result, &failed);
+    if (sampled) {
+        STAT_STOP(ring, STAT_PARSE, parse_start);
+    }
+    if (length > 0) {
+        RingCommit(length);
+    }
+    return failed ? -1 : 0;
+}
+
+// Возвращает начало необработанного хвоста или NULL, если разбор прерван ошибкой.
+const char *ProcessLines(const char *current, const char *end) {
+    const char *newline;
+
+    while ((newline = memchr(current, '\n', end - current)) != NULL) {
+        if (ProcessLine(current, newline) == -1) {
+            return NULL;
+        }
+        current = newline + 1;
+    }
+    return current;
+}
+
+// Разбор прямо из page cache без копирования во временный буфер.
+int ProcessMapped(int file, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+
+    char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (data == MAP_FAILED) {
+        HandleError("Ошибка отображения файла в память.\n");
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    const char *tail = ProcessLines(data, data + size);
+    int status = 0;
+    if (tail == NULL) {
+        status = -1;
+    } else if (tail < data + size) {
+        status = ProcessLine(tail, data + size);
+    }
+
+    munmap(data, size);
+    return status;
+}
+
+// Потоковый разбор для файлов, которые нельзя отобразить: хвост без '\n' переносится в начало буфера.
+int ProcessStream(int file) {
+    size_t capacity = READ_CHUNK_SIZE;
+    size_t filled = 0;
+    char *buffer = malloc(capacity);
+    if (buffer == NULL) {
+        HandleError("Ошибка выделения памяти для буфера чтения.\n");
     }
 
-    char buffer[BUFFER_SIZE];
     ssize_t bytesRead;
-    int first_number, next_number;
-    char *current;
-    int line_number = 0;
-
-    while ((bytesRead = read(file, buffer, BUFFER_SIZE)) > 0) {
-        current = buffer;
-
-        while (current < buffer + bytesRead) {
-            while (*current == ' ' || *current == '\t') current++;
-            if (*current == '\n') {
-                current++;
-                continue;
+    while (1) {
+        // Чтение из канала может надолго заблокироваться: готовые результаты отдаются parent до него.
+        RingNotify(&ring->head, &ring->consumer_waiting);
+        bytesRead = read(file, buffer + filled, capacity - filled);
+        if (bytesRead <= 0) {
+            break;
+        }
+
+        const char *end = buffer + filled + bytesRead;
+        const char *current = ProcessLines(buffer, end);
+        if (current == NULL) {
+            free(buffer);
+            return -1;
+        }
+
+        filled = end - current;
+        memmove(buffer, current, filled);
+
+        if (filled == capacity) {
+            capacity *= 2;
+            buffer = realloc(buffer, capacity);
+            if (buffer == NULL) {
+                HandleError("Ошибка выделения памяти для буфера чтения.\n");
             }
+        }
+    }
 
-            char *endptr;
-            first_number = safe_strtol(current, &endptr);
-            current = endptr;
+    int status = 0;
+    if (bytesRead == -1) {
+        RingPushMessage("Ошибка чтения файла.\n");
+        status = -1;
+    } else if (filled > 0) {
+        status = ProcessLine(buffer, buffer + filled);
+    }
+    free(buffer);
+    return status;
+}
+
+// Конвейер внутри child (-t N): поток чтения режет вход на куски по границам строк, N потоков разбора
+// форматируют куски в свои буферы записей, а основной поток копирует готовые куски в кольцо строго
+// по порядку. Parent видит тот же поток записей, что и при однопоточном разборе.
+typedef enum {
+    CHUNK_FREE,
+    CHUNK_READY,
+    CHUNK_PARSING,
+    CHUNK_PARSED
+} ChunkState;
+
+typedef struct {
+    ChunkState state;
+    const char *start;
+    const char *end;
+    // Собственный буфер входа для потокового чтения; для mmap куски указывают прямо в отображение.
+    char *input;
+    size_t input_capacity;
+    int read_failed;
+    // Готовые записи [длина][текст] в формате кольца.
+    char *output;
+    size_t output_len;
+    size_t output_capacity;
+    int failed;
+} Chunk;
 
-            char result[BUFFER_SIZE];
-            int result_len = snprintf(result, BUFFER_SIZE, "Результат: %d", first_number);
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    Chunk *chunks;
+    size_t chunk_count;
+    size_t produced;
+    size_t next_to_parse;
+    int input_done;
+    int stopped;
+    int shutdown;
+    int parser_threads;
+    int file;
+    const char *mapped;
+    size_t mapped_size;
+} Pipeline;
 
-            while (current < buffer + bytesRead && *current != '\n') {
-                while (*current == ' ' || *current == '\t') current++;
-                if (*current == '\n') break;
+int parser_threads = 1;
+// Потоки разбора и куски создаются при первом файле и служат всем следующим файлам worker.
+Pipeline pipeline;
+pthread_t parsers[MAX_PARSER_THREADS];
+
+// Ждёт, пока слот очередного куска освободится; NULL, если конвейер уже остановлен.
+Chunk *PipelineAcquireFree(Pipeline *pipeline) {
+    Chunk *chunk = &pipeline->chunks[pipeline->produced % pipeline->chunk_count];
+
+    pthread_mutex_lock(&pipeline->mutex);
+    while (chunk->state != CHUNK_FREE && !pipeline->stopped) {
+        pthread_cond_wait(&pipeline->changed, &pipeline->mutex);
+    }
+    int stopped = pipeline->stopped;
+    pthread_mutex_unlock(&pipeline->mutex);
+    return stopped ? NULL : chunk;
+}
+
+void PipelineSubmit(Pipeline *pipeline, Chunk *chunk, int last) {
+    pthread_mutex_lock(&pipeline->mutex);
+    chunk->state = CHUNK_READY;
+    pipeline->produced++;
+    pipeline->input_done = last;
+    pthread_cond_broadcast(&pipeline->changed);
+    pthread_mutex_unlock(&pipeline->mutex);
+}
+
+// Поток чтения. Для mmap только нарезает отображение, для канала читает в буфер куска и переносит
+// неполную последнюю строку в начало следующего.
+void *PipelineReader(void *argument) {
+    Pipeline *pipeline = argument;
+
+    if (pipeline->mapped != NULL) {
+        const char *current = pipeline->mapped;
+        const char *end = pipeline->mapped + pipeline->mapped_size;
+        while (current < end) {
+            Chunk *chunk = PipelineAcquireFree(pipeline);
+            if (chunk == NULL) {
+                return NULL;
+            }
+            const char *split = end;
+            if ((size_t)(end - current) > PIPE_CHUNK_SIZE) {
+                const char *newline = memchr(current + PIPE_CHUNK_SIZE, '\n', end - current - PIPE_CHUNK_SIZE);
+                split = newline != NULL ? newline + 1 : end;
+            }
+            chunk->start = current;
+            chunk->end = split;
+            current = split;
+            PipelineSubmit(pipeline, chunk, current == end);
+        }
+        return NULL;
+    }
 
-                next_number = safe_strtol(current, &endptr);
-                if (next_number == 0) {
-                    strncpy(shared_mem + line_number * BUFFER_SIZE, "Ошибка: Деление на ноль.\n", BUFFER_SIZE);
-                    sem_post(semaphore);
-                    exit(EXIT_FAILURE);
+    char *carry = NULL;
+    size_t carry_len = 0;
+    int last = 0;
+
+    while (!last) {
+        Chunk *chunk = PipelineAcquireFree(pipeline);
+        if (chunk == NULL) {
+            break;
+        }
+        if (chunk->input_capacity < carry_len + PIPE_CHUNK_SIZE) {
+            chunk->input_capacity = carry_len + PIPE_CHUNK_SIZE;
+            chunk->input = realloc(chunk->input, chunk->input_capacity);
+            if (chunk->input == NULL) {
+                HandleError("Ошибка выделения памяти для буфера чтения.\n");
+            }
+        }
+        memcpy(chunk->input, carry, carry_len);
+        size_t filled = carry_len;
+        const char *split = NULL;
+
+        // Читаем, пока в куске нет ни одной целой строки, иначе разбору нечего делать.
+        while (split == NULL) {
+            if (filled == chunk->input_capacity) {
+                chunk->input_capacity *= 2;
+                chunk->input = realloc(chunk->input, chunk->input_capacity);
+                if (chunk->input == NULL) {
+                    HandleError("Ошибка выделения памяти для буфера чтения.\n");
+                }
+            }
+            ssize_t bytesRead = read(pipeline->file, chunk->input + filled, chunk->input_capacity - filled);
+            if (bytesRead <= 0) {
+                chunk->read_failed = (bytesRead == -1);
+                last = 1;
+                split = chunk->input + filled;
+                break;
+            }
+            filled += bytesRead;
+            if (filled >= PIPE_CHUNK_SIZE || filled == chunk->input_capacity) {
+                split = memrchr(chunk->input, '\n', filled);
+                if (split != NULL) {
+                    split++;
                 }
+            }
+        }
+
+        carry_len = chunk->input + filled - split;
+        carry = realloc(carry, carry_len > 0 ? carry_len : 1);
+        if (carry == NULL) {
+            HandleError("Ошибка выделения памяти для буфера чтения.\n");
+        }
+        memcpy(carry, split, carry_len);
+
+        chunk->start = chunk->input;
+        chunk->end = split;
+        PipelineSubmit(pipeline, chunk, last);
+    }
+
+    free(carry);
+    return NULL;
+}
 
-                result_len += snprintf(result + result_len, BUFFER_SIZE - result_len, ", %d / %d = %d",
-                                       first_number, next_number, first_number / next_number);
-                current = endptr;
+// Форматирует строки куска в его буфер записей. Последняя строка файла может быть без '\n'.
+void ParseChunk(Chunk *chunk) {
+    const char *current = chunk->start;
+    chunk->output_len = 0;
+    chunk->failed = 0;
+
+    while (current < chunk->end && !chunk->failed) {
+        const char *newline = memchr(current, '\n', chunk->end - current);
+        const char *line_end = newline != NULL ? newline : chunk->end;
+
+        if (chunk->output_capacity - chunk->output_len < RECORD_SIZE(BUFFER_SIZE)) {
+            chunk->output_capacity = chunk->output_capacity * 2 + RECORD_SIZE(BUFFER_SIZE);
+            chunk->output = realloc(chunk->output, chunk->output_capacity);
+            if (chunk->output == NULL) {
+                HandleError("Ошибка выделения памяти для результатов.\n");
             }
+        }
+
+        char *record = chunk->output + chunk->output_len;
+        STAT_DECLARE(parse_start);
+        int sampled = STAT_SAMPLED(parse_samples);
+        if (sampled) {
+            STAT_START(parse_start);
+        }
+        size_t length = FormatLine(current, line_end, record + sizeof(uint32_t), &chunk->failed);
+        if (sampled) {
+            STAT_STOP(ring, STAT_PARSE, parse_start);
+        }
+        if (length > 0) {
+            *(uint32_t *)record = length;
+            chunk->output_len += RECORD_SIZE(length);
+        }
+        current = line_end + 1;
+    }
+
+    if (chunk->read_failed && !chunk->failed) {
+        const char *message = "Ошибка чтения файла.\n";
+        char *record = chunk->output + chunk->output_len;
+        *(uint32_t *)record = strlen(message);
+        memcpy(record + sizeof(uint32_t), message, strlen(message));
+        chunk->output_len += RECORD_SIZE(strlen(message));
+        chunk->failed = 1;
+    }
+}
+
+void *PipelineParser(void *argument) {
+    Pipeline *pipeline = argument;
+
+    if (cache_budget > 0) {
+        InitCache(cache_budget / pipeline->parser_threads);
+    }
+
+    pthread_mutex_lock(&pipeline->mutex);
+    while (1) {
+        // Пока этот поток спал, очередной кусок мог забрать другой, поэтому кусок выбирается заново.
+        // Между файлами и после остановки файла поток ждёт здесь следующего файла.
+        Chunk *chunk = &pipeline->chunks[pipeline->next_to_parse % pipeline->chunk_count];
+        while (!pipeline->shutdown && (pipeline->stopped || chunk->state != CHUNK_READY)) {
+            pthread_cond_wait(&pipeline->changed, &pipeline->mutex);
+            chunk = &pipeline->chunks[pipeline->next_to_parse % pipeline->chunk_count];
+        }
+        if (pipeline->shutdown) {
+            break;
+        }
+        chunk->state = CHUNK_PARSING;
+        pipeline->next_to_parse++;
+        pthread_mutex_unlock(&pipeline->mutex);
+
+        ParseChunk(chunk);
+
+        pthread_mutex_lock(&pipeline->mutex);
+        chunk->state = CHUNK_PARSED;
+        pthread_cond_broadcast(&pipeline->changed);
+    }
+    pthread_mutex_unlock(&pipeline->mutex);
 
-            result[result_len++] = '\n';
-            strncpy(shared_mem + line_number * BUFFER_SIZE, result, result_len);
-            line_number++;
+    MergeCacheStats();
+    return NULL;
+}
+
+void StartPipeline(void) {
+    pthread_mutex_init(&pipeline.mutex, NULL);
+    pthread_cond_init(&pipeline.changed, NULL);
+    pipeline.parser_threads = parser_threads;
+    pipeline.chunk_count = parser_threads * PIPE_CHUNKS_PER_THREAD + 1;
+    pipeline.chunks = calloc(pipeline.chunk_count, sizeof(Chunk));
+    if (pipeline.chunks == NULL) {
+        HandleError("Ошибка выделения памяти для конвейера.\n");
+    }
 
-            if (line_number >= NUM_LINES) break;
+    for (int i = 0; i < parser_threads; i++) {
+        if (pthread_create(&parsers[i], NULL, PipelineParser, &pipeline) != 0) {
+            HandleError("Ошибка создания потока разбора.\n");
         }
     }
+}
+
+// Завершает потоки разбора (они сливают статистику кэша) до того, как atexit напечатает её.
+void StopPipeline(void) {
+    if (pipeline.chunks == NULL) {
+        return;
+    }
 
-    if (bytesRead == -1) {
-        strncpy(shared_mem, "Ошибка чтения файла.\n", BUFFER_SIZE);
-        sem_post(semaphore);
-        exit(EXIT_FAILURE);
+    pthread_mutex_lock(&pipeline.mutex);
+    pipeline.shutdown = 1;
+    pthread_cond_broadcast(&pipeline.changed);
+    pthread_mutex_unlock(&pipeline.mutex);
+    for (int i = 0; i < parser_threads; i++) {
+        pthread_join(parsers[i], NULL);
+    }
+
+    for (size_t i = 0; i < pipeline.chunk_count; i++) {
+        free(pipeline.chunks[i].input);
+        free(pipeline.chunks[i].output);
+    }
+    free(pipeline.chunks);
+    pipeline.chunks = NULL;
+    pthread_cond_destroy(&pipeline.changed);
+    pthread_mutex_destroy(&pipeline.mutex);
+}
+
+// Основной поток -- упорядоченный писатель: куски уходят в кольцо в порядке входа.
+int ProcessPipelined(int file, const char *mapped, size_t mapped_size) {
+    pthread_t reader;
+
+    if (pipeline.chunks == NULL) {
+        StartPipeline();
+    }
+
+    // Все куски свободны, а потоки разбора ждут: предыдущий файл дождался их перед возвратом.
+    pthread_mutex_lock(&pipeline.mutex);
+    for (size_t i = 0; i < pipeline.chunk_count; i++) {
+        pipeline.chunks[i].state = CHUNK_FREE;
+        pipeline.chunks[i].read_failed = 0;
+    }
+    pipeline.produced = 0;
+    pipeline.next_to_parse = 0;
+    pipeline.input_done = 0;
+    pipeline.stopped = 0;
+    pipeline.file = file;
+    pipeline.mapped = mapped;
+    pipeline.mapped_size = mapped_size;
+    pthread_mutex_unlock(&pipeline.mutex);
+
+    if (pthread_create(&reader, NULL, PipelineReader, &pipeline) != 0) {
+        HandleError("Ошибка создания потока чтения.\n");
+    }
+
+    int status = 0;
+    for (size_t written = 0;; written++) {
+        Chunk *chunk = &pipeline.chunks[written % pipeline.chunk_count];
+
+        pthread_mutex_lock(&pipeline.mutex);
+        if (chunk->state != CHUNK_PARSED) {
+            // Пока следующий кусок не готов, отдаём parent всё, что уже лежит в кольце.
+            RingNotify(&ring->head, &ring->consumer_waiting);
+        }
+        while (chunk->state != CHUNK_PARSED && !(pipeline.input_done && written == pipeline.produced)) {
+            pthread_cond_wait(&pipeline.changed, &pipeline.mutex);
+        }
+        pthread_mutex_unlock(&pipeline.mutex);
+        if (chunk->state != CHUNK_PARSED) {
+            break;
+        }
+
+        RingWriteRecords(chunk->output, chunk->output_len);
+
+        pthread_mutex_lock(&pipeline.mutex);
+        chunk->state = CHUNK_FREE;
+        if (chunk->failed) {
+            pipeline.stopped = 1;
+            status = -1;
+        }
+        pthread_cond_broadcast(&pipeline.changed);
+        pthread_mutex_unlock(&pipeline.mutex);
+        if (status == -1) {
+            break;
+        }
+    }
+
+    pthread_join(reader, NULL);
+
+    // После ошибки потоки разбора могли ещё не закончить взятые куски; они нужны следующему файлу.
+    pthread_mutex_lock(&pipeline.mutex);
+    for (size_t i = 0; i < pipeline.chunk_count; i++) {
+        while (pipeline.chunks[i].state == CHUNK_PARSING) {
+            pthread_cond_wait(&pipeline.changed, &pipeline.mutex);
+        }
+    }
+    pthread_mutex_unlock(&pipeline.mutex);
+    return status;
+}
+
+int ProcessPipelinedFile(int file, off_t size) {
+    if (size <= 0) {
+        return ProcessPipelined(file, NULL, 0);
+    }
+
+    char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (data == MAP_FAILED) {
+        HandleError("Ошибка отображения файла в память.\n");
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    int status = ProcessPipelined(file, data, size);
+    munmap(data, size);
+    return status;
+}
+
+// Выводит результаты одного файла и закрывает их записью RECORD_END. Возвращает -1 при ошибке.
+int ProcessFile(const char *filename) {
+    int status;
+    STAT_DECLARE(open_start);
+    STAT_START(open_start);
+    int file = open(filename, O_RDONLY);
+    STAT_STOP(ring, STAT_OPEN, open_start);
+    if (file == -1) {
+        RingPushMessage("Ошибка: Не удалось открыть файл.\n");
+        status = -1;
+    } else {
+        struct stat st;
+        int regular = fstat(file, &st) == 0 && S_ISREG(st.st_mode);
+        if (parser_threads > 1) {
+            status = ProcessPipelinedFile(file, regular ? st.st_size : -1);
+        } else if (regular) {
+            status = ProcessMapped(file, st.st_size);
+        } else {
+            status = ProcessStream(file);
+        }
+        close(file);
+    }
+
+    RingEndJob();
+    return status;
+}
+
+// Режим пула: worker забирает задания, пока parent не объявит shutdown и очередь не опустеет.
+void ServeJobs(uint32_t worker_id) {
+    char filename[BUFFER_SIZE];
+
+    while (1) {
+        uint32_t claimed = __atomic_load_n(&queue->claimed, __ATOMIC_ACQUIRE);
+        uint32_t submitted = __atomic_load_n(&queue->submitted, __ATOMIC_ACQUIRE);
+
+        if (claimed == submitted) {
+            if (__atomic_load_n(&queue->shutdown, __ATOMIC_ACQUIRE)
+                && claimed == __atomic_load_n(&queue->submitted, __ATOMIC_ACQUIRE)) {
+                return;
+            }
+            RingWait(queue->spin_limit, &queue->submitted, submitted, &queue->workers_waiting, &queue->shutdown);
+            continue;
+        }
+        if (!__atomic_compare_exchange_n(&queue->claimed, &claimed, claimed + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+
+        Job *job = &queue->jobs[claimed % JOB_SLOTS];
+        // parent кладёт в задание имя вместе с завершающим нулём.
+        memcpy(filename, job->filename, BUFFER_SIZE);
+        __atomic_store_n(&job->worker, worker_id + 1, __ATOMIC_RELEASE);
+        RingNotify(&job->worker, &queue->parent_waiting);
+
+        ProcessFile(filename);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+
+    // Без parent читать кольцо некому: при его гибели child завершается, а не ждёт свободного слота вечно.
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (getppid() == 1) {
+        HandleError("Ошибка: родительский процесс уже завершился.\n");
+    }
+
+    // -c BYTES: кэшировать результаты повторяющихся строк в пределах BYTES байт.
+    // -w ID: работать worker пула с номером ID и брать задания из очереди на JOBS_FD.
+    // -t N: разбирать файл конвейером из потока чтения и N потоков разбора.
+    long worker_id = -1;
+    while ((opt = getopt(argc, argv, "c:w:t:")) != -1) {
+        switch (opt) {
+            case 'c': cache_budget = strtoul(optarg, NULL, 10); break;
+            case 'w': worker_id = strtol(optarg, NULL, 10); break;
+            case 't': parser_threads = atoi(optarg); break;
+            default: HandleError("Использование: ./child [-c БАЙТ] [-w НОМЕР] [-t ПОТОКОВ]\n");
+        }
+    }
+    if (parser_threads < 1 || parser_threads > MAX_PARSER_THREADS) {
+        HandleError("Ошибка: неверное число потоков разбора.\n");
+    }
+    if (cache_budget > 0) {
+        if (parser_threads == 1) {
+            InitCache(cache_budget);
+        }
+        atexit(ReportCacheStats);
+    }
+
+    struct stat shared_st;
+    if (fstat(SHARED_FD, &shared_st) == -1) {
+        HandleError("Ошибка подключения к разделяемой памяти.\n");
+    }
+
+    ring = mmap(NULL, shared_st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, SHARED_FD, 0);
+    if (ring == MAP_FAILED) {
+        HandleError("Ошибка отображения разделяемой памяти.\n");
+    }
+    close(SHARED_FD);
+
+    if (worker_id >= 0) {
+        if (fstat(JOBS_FD, &shared_st) == -1) {
+            HandleError("Ошибка подключения к очереди заданий.\n");
+        }
+        queue = mmap(NULL, shared_st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, JOBS_FD, 0);
+        if (queue == MAP_FAILED) {
+            HandleError("Ошибка отображения очереди заданий.\n");
+        }
+        close(JOBS_FD);
+
+        ServeJobs(worker_id);
+        StopPipeline();
+        exit(EXIT_SUCCESS);
     }
 
-    close(file);
-    sem_post(semaphore);
-    exit(EXIT_SUCCESS);
+    int status = ProcessFile(ring->filename);
+    StopPipeline();
+    exit(status == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
 }
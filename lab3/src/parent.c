@@ -1,15 +1,18 @@
+#define _GNU_SOURCE
 #include <unistd.h>
+#include <limits.h>
 #include <sys/mman.h>
+#include <sys/uio.h>
 #include <fcntl.h>
-#include <semaphore.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include "shared.h"
 
-#define SHM_NAME "/shared_memory"
-#define SEM_NAME "/sync_semaphore"
-#define BUFFER_SIZE 1024
-#define NUM_LINES 100
+#define DRAIN_BATCH IOV_MAX
+#define POOL_INPUT_SIZE (64 * 1024)
 
 void error_handler(const char *msg) {
     write(STDERR_FILENO, msg, strlen(msg));
@@ -17,74 +20,413 @@ void error_handler(const char *msg) {
     exit(EXIT_FAILURE);
 }
 
-int main() {
-    int shm_fd;
-    char *shared_mem;
-    sem_t *semaphore;
-    ssize_t bytesRead;
+// Размер данных кольца по размеру входа: результат строки в несколько раз длиннее самой строки, и при
+// запасе в 8 раз небольшой файл целиком помещается в кольцо, а большой упирается в RING_MAX_BYTES.
+uint32_t RingCapacity(const char *filename) {
+    struct stat st;
+    if (stat(filename, &st) == -1 || !S_ISREG(st.st_mode)) {
+        return RING_DEFAULT_BYTES;
+    }
 
-    shm_fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0666);
-    if (shm_fd == -1) {
-        error_handler("Ошибка создания разделяемой памяти");
+    uint32_t capacity = RING_MIN_BYTES;
+    while (capacity < RING_MAX_BYTES && (unsigned long long)capacity < (unsigned long long)st.st_size * 8) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+// Создаёт memfd под заголовок и данные кольца. Большие сегменты сначала пробуют на огромных страницах:
+// меньше промахов TLB у обеих сторон. Если их нет в системе, берётся обычный memfd.
+SharedRing *CreateSharedRing(uint32_t capacity, int *memfd, size_t *size) {
+    *size = sizeof(SharedRing) + capacity;
+    *memfd = -1;
+
+    if (*size >= RING_HUGE_PAGE) {
+        size_t huge_size = (*size + RING_HUGE_PAGE - 1) & ~(size_t)(RING_HUGE_PAGE - 1);
+        *memfd = memfd_create("ring", MFD_HUGETLB);
+        if (*memfd != -1 && ftruncate(*memfd, huge_size) == 0) {
+            SharedRing *ring = mmap(NULL, huge_size, PROT_READ | PROT_WRITE, MAP_SHARED, *memfd, 0);
+            if (ring != MAP_FAILED) {
+                *size = huge_size;
+                return ring;
+            }
+        }
+        if (*memfd != -1) {
+            close(*memfd);
+        }
     }
 
-    if (ftruncate(shm_fd, BUFFER_SIZE * NUM_LINES) == -1) {
+    *memfd = memfd_create("ring", 0);
+    if (*memfd == -1) {
+        error_handler("Ошибка создания разделяемой памяти");
+    }
+    if (ftruncate(*memfd, *size) == -1) {
         error_handler("Ошибка изменения размера разделяемой памяти");
     }
 
-    shared_mem = mmap(NULL, BUFFER_SIZE * NUM_LINES, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-    if (shared_mem == MAP_FAILED) {
+    SharedRing *ring = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, *memfd, 0);
+    if (ring == MAP_FAILED) {
         error_handler("Ошибка отображения разделяемой памяти");
     }
+    return ring;
+}
 
-    semaphore = sem_open(SEM_NAME, O_CREAT, 0666, 0);
-    if (semaphore == SEM_FAILED) {
-        error_handler("Ошибка создания семафора");
+void WritevAll(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if (written == -1) {
+            error_handler("Ошибка вывода результата");
+        }
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
     }
+}
 
-    char filename[BUFFER_SIZE];
-    const char *prompt = "Введите имя файла: ";
-    write(STDOUT_FILENO, prompt, strlen(prompt));
-    bytesRead = read(STDIN_FILENO, filename, sizeof(filename));
-    if (bytesRead <= 0) {
-        error_handler("Ошибка чтения имени файла");
+// Проверяет, завершился ли процесс, не забирая его статус: ждать его потом всё равно будет вызывающий.
+int ChildExited(pid_t pid) {
+    siginfo_t info;
+    info.si_pid = 0;
+    return waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == pid;
+}
+
+// Печатает результаты одного файла по мере того, как child публикует их в кольце, и освобождает место.
+// Заканчивает на записи RECORD_END; child, умерший раньше неё, считается завершившимся аварийно.
+// child может опубликовать последние записи и выйти между проверкой head и проверкой процесса, поэтому
+// после его выхода head перечитывается, и ошибкой считается только пустое кольцо без RECORD_END.
+void DrainJob(SharedRing *ring, pid_t child_pid) {
+    uint32_t tail = ring->tail;
+    int ended = 0;
+    uint32_t handoff_seq = 0;
+
+    while (!ended) {
+        uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+        if (head != tail) {
+            STAT_TAKE_HANDOFF(ring, tail, head, handoff_seq);
+            struct iovec iov[DRAIN_BATCH];
+            int count = 0;
+            uint32_t position = tail;
+            while (position != head && count < DRAIN_BATCH) {
+                uint32_t offset = position & (ring->capacity - 1);
+                uint32_t length = *(uint32_t *)(ring->data + offset);
+                if (length == RECORD_WRAP) {
+                    position += ring->capacity - offset;
+                    continue;
+                }
+                if (length == RECORD_END) {
+                    position += RECORD_SIZE(0);
+                    ended = 1;
+                    break;
+                }
+                iov[count].iov_base = ring->data + offset + sizeof(uint32_t);
+                iov[count].iov_len = length;
+                count++;
+                position += RECORD_SIZE(length);
+            }
+            STAT_DECLARE(output_start);
+            STAT_START(output_start);
+            WritevAll(STDOUT_FILENO, iov, count);
+            STAT_STOP(ring, STAT_OUTPUT, output_start);
+
+            tail = position;
+            __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+            RingNotify(&ring->tail, &ring->producer_waiting);
+            continue;
+        }
+
+        __atomic_store_n(&ring->consumer_wake_at, tail + ring->capacity / 4, __ATOMIC_RELAXED);
+        STAT_DECLARE(wait_start);
+        STAT_START(wait_start);
+        RingWait(ring->spin_limit, &ring->head, tail, &ring->consumer_waiting, NULL);
+        STAT_STOP(ring, STAT_CONSUMER_WAIT, wait_start);
+        if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail && ChildExited(child_pid) &&
+            __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) {
+            error_handler("Ошибка: дочерний процесс завершился аварийно");
+        }
     }
+}
 
-    size_t len = strlen(filename);
-    if (len > 0 && filename[len - 1] == '\n') {
-        filename[len - 1] = '\0';
+#ifdef LAB3_STATS
+// Сводка замеров по всем кольцам: число событий, p50/p99/max на этап, в stderr.
+uint64_t StatPercentile(const StatHistogram *histogram, double fraction) {
+    uint64_t rank = (uint64_t)(histogram->count * fraction);
+    uint64_t seen = 0;
+    for (unsigned bucket = 0; bucket < STAT_BUCKETS; bucket++) {
+        seen += histogram->buckets[bucket];
+        if (seen > rank) {
+            uint64_t limit = StatBucketLimit(bucket);
+            return limit < histogram->max ? limit : histogram->max;
+        }
     }
+    return histogram->max;
+}
+
+void ReportStats(SharedRing **rings, int ring_count) {
+    static const char *names[STAT_STAGES] = {
+        "открытие файла",
+        "разбор строки",
+        "запись в кольцо",
+        "ожидание места в кольце",
+        "ожидание результатов",
+        "вывод parent",
+        "передача записи",
+    };
+
+    for (int stage = 0; stage < STAT_STAGES; stage++) {
+        StatHistogram total = {0};
+        for (int r = 0; r < ring_count; r++) {
+            const StatHistogram *histogram = &rings[r]->stats.stages[stage];
+            total.count += histogram->count;
+            if (histogram->max > total.max) {
+                total.max = histogram->max;
+            }
+            for (unsigned bucket = 0; bucket < STAT_BUCKETS; bucket++) {
+                total.buckets[bucket] += histogram->buckets[bucket];
+            }
+        }
+        if (total.count == 0) {
+            continue;
+        }
 
-    strncpy(shared_mem, filename, BUFFER_SIZE);
+        char line[BUFFER_SIZE];
+        int line_len = snprintf(line, sizeof(line), "[STATS] %s: n=%llu, p50=%.2f мкс, p99=%.2f мкс, max=%.2f мкс\n",
+                                names[stage], (unsigned long long)total.count,
+                                StatPercentile(&total, 0.5) / 1000.0, StatPercentile(&total, 0.99) / 1000.0,
+                                total.max / 1000.0);
+        write(STDERR_FILENO, line, line_len);
+    }
+}
+#endif
 
+// Запускает child с кольцом на SHARED_FD; для worker пула ещё и с очередью заданий на JOBS_FD.
+pid_t SpawnChild(int memfd, int jobs_fd, int worker_id, const char *cache_budget, const char *threads) {
     pid_t child_pid = fork();
     if (child_pid == -1) {
         error_handler("Ошибка создания дочернего процесса");
     }
+    if (child_pid != 0) {
+        return child_pid;
+    }
 
-    if (child_pid == 0) {
-        execl("./child", "./child", NULL);
-        error_handler("Ошибка выполнения дочернего процесса");
-    } else {
-        sem_post(semaphore);
+    // Сначала уводим очередь с номера SHARED_FD, если memfd_create выдал его именно ей.
+    if (jobs_fd == SHARED_FD) {
+        jobs_fd = dup(jobs_fd);
+    }
+    if ((memfd != SHARED_FD && dup2(memfd, SHARED_FD) == -1)
+        || (jobs_fd != -1 && jobs_fd != JOBS_FD && dup2(jobs_fd, JOBS_FD) == -1)) {
+        error_handler("Ошибка передачи разделяемой памяти дочернему процессу");
+    }
+
+    char worker[16];
+    char *args[10];
+    int arg_count = 0;
+    args[arg_count++] = "./child";
+    if (cache_budget != NULL) {
+        args[arg_count++] = "-c";
+        args[arg_count++] = (char *)cache_budget;
+    }
+    if (threads != NULL) {
+        args[arg_count++] = "-t";
+        args[arg_count++] = (char *)threads;
+    }
+    if (worker_id >= 0) {
+        snprintf(worker, sizeof(worker), "%d", worker_id);
+        args[arg_count++] = "-w";
+        args[arg_count++] = worker;
+    }
+    args[arg_count] = NULL;
 
-        wait(NULL);
+    execv("./child", args);
+    error_handler("Ошибка выполнения дочернего процесса");
+    return -1;
+}
 
-        for (int i = 0; i < NUM_LINES; i++) {
-            if (strlen(shared_mem + i * BUFFER_SIZE) > 0) {
-                write(
-                        STDOUT_FILENO, shared_mem + i * BUFFER_SIZE, strlen(
-                                shared_mem + i * BUFFER_SIZE
-                                )
-                        );
+SharedRing *CreateChildRing(uint32_t capacity, int *memfd, size_t *ring_size, uint32_t spin_limit) {
+    SharedRing *ring = CreateSharedRing(capacity, memfd, ring_size);
+    ring->capacity = capacity;
+    ring->spin_limit = spin_limit;
+    return ring;
+}
+
+// Дожидается, пока задание возьмёт какой-нибудь worker, и печатает его результаты из кольца этого worker.
+// До завершения работы worker не выходят, поэтому выход любого из них -- авария.
+void PrintJob(JobQueue *queue, SharedRing **rings, pid_t *pids, int workers, uint32_t index) {
+    Job *job = &queue->jobs[index % JOB_SLOTS];
+    uint32_t worker;
+
+    while ((worker = __atomic_load_n(&job->worker, __ATOMIC_ACQUIRE)) == 0) {
+        RingWait(queue->spin_limit, &job->worker, 0, &queue->parent_waiting, NULL);
+        for (int w = 0; w < workers && __atomic_load_n(&job->worker, __ATOMIC_ACQUIRE) == 0; w++) {
+            if (ChildExited(pids[w])) {
+                error_handler("Ошибка: дочерний процесс завершился аварийно");
+            }
+        }
+    }
+    DrainJob(rings[worker - 1], pids[worker - 1]);
+}
+
+// Режим пула: K worker запускаются один раз, а имена файлов (по одному в строке stdin) раздаются им
+// через очередь заданий. Результаты печатаются в порядке имён, независимо от того, кто их посчитал.
+void RunPool(int workers, const char *cache_budget, const char *threads, uint32_t spin_limit) {
+    SharedRing *rings[MAX_WORKERS];
+    size_t ring_sizes[MAX_WORKERS];
+    pid_t pids[MAX_WORKERS];
+
+    int jobs_fd = memfd_create("jobs", 0);
+    if (jobs_fd == -1 || ftruncate(jobs_fd, sizeof(JobQueue)) == -1) {
+        error_handler("Ошибка создания очереди заданий");
+    }
+    JobQueue *queue = mmap(NULL, sizeof(JobQueue), PROT_READ | PROT_WRITE, MAP_SHARED, jobs_fd, 0);
+    if (queue == MAP_FAILED) {
+        error_handler("Ошибка отображения очереди заданий");
+    }
+    queue->spin_limit = spin_limit;
+
+    for (int w = 0; w < workers; w++) {
+        int memfd;
+        rings[w] = CreateChildRing(RING_POOL_BYTES, &memfd, &ring_sizes[w], spin_limit);
+        pids[w] = SpawnChild(memfd, jobs_fd, w, cache_budget, threads);
+        close(memfd);
+    }
+    close(jobs_fd);
+
+    const char *prompt = "Введите имена файлов (по одному в строке): ";
+    write(STDOUT_FILENO, prompt, strlen(prompt));
+
+    char names[POOL_INPUT_SIZE];
+    size_t filled = 0;
+    uint32_t submitted = 0;
+    uint32_t retired = 0;
+    ssize_t bytesRead;
+    int input_done = 0;
+
+    while (!input_done) {
+        bytesRead = read(STDIN_FILENO, names + filled, sizeof(names) - filled);
+        if (bytesRead == -1) {
+            error_handler("Ошибка чтения имени файла");
+        }
+        if (bytesRead == 0) {
+            // Последнее имя может быть без перевода строки.
+            input_done = 1;
+            names[filled++] = '\n';
+        }
+        filled += bytesRead;
+
+        char *current = names;
+        char *newline;
+        while ((newline = memchr(current, '\n', names + filled - current)) != NULL) {
+            *newline = '\0';
+            if (newline > current) {
+                if (submitted - retired == JOB_SLOTS) {
+                    PrintJob(queue, rings, pids, workers, retired++);
+                }
+                Job *job = &queue->jobs[submitted % JOB_SLOTS];
+                job->worker = 0;
+                size_t name_len = newline - current;
+                if (name_len >= BUFFER_SIZE) {
+                    error_handler("Ошибка: слишком длинное имя файла");
+                }
+                memcpy(job->filename, current, name_len + 1);
+                __atomic_store_n(&queue->submitted, ++submitted, __ATOMIC_RELEASE);
+                RingNotify(&queue->submitted, &queue->workers_waiting);
             }
+            current = newline + 1;
+        }
+
+        filled = names + filled - current;
+        memmove(names, current, filled);
+        if (filled == sizeof(names)) {
+            error_handler("Ошибка: слишком длинное имя файла");
+        }
+
+        // Перед следующим чтением, которое может ждать пользователя, печатаем всё уже отправленное.
+        while (retired != submitted) {
+            PrintJob(queue, rings, pids, workers, retired++);
+        }
+    }
+
+    __atomic_store_n(&queue->shutdown, 1, __ATOMIC_RELEASE);
+    RingNotify(&queue->submitted, &queue->workers_waiting);
+    for (int w = 0; w < workers; w++) {
+        if (waitpid(pids[w], NULL, 0) == -1) {
+            error_handler("Ошибка ожидания дочернего процесса");
         }
+    }
+#ifdef LAB3_STATS
+    ReportStats(rings, workers);
+#endif
+    for (int w = 0; w < workers; w++) {
+        munmap(rings[w], ring_sizes[w]);
+    }
+    munmap(queue, sizeof(JobQueue));
+}
 
-        munmap(shared_mem, BUFFER_SIZE * NUM_LINES);
-        shm_unlink(SHM_NAME);
-        sem_close(semaphore);
-        sem_unlink(SEM_NAME);
+int main(int argc, char *argv[]) {
+    int memfd;
+    size_t ring_size;
+    SharedRing *ring;
+    ssize_t bytesRead;
+    const char *cache_budget = NULL;
+    const char *threads = NULL;
+    int workers = 0;
+    int opt;
 
+    // -c BYTES передаётся child: кэш результатов для повторяющихся строк.
+    // -p K: пул из K постоянных worker, имена файлов читаются из stdin до конца ввода.
+    // -t N передаётся child: разбор файла конвейером из N потоков.
+    while ((opt = getopt(argc, argv, "c:p:t:")) != -1) {
+        switch (opt) {
+            case 'c': cache_budget = optarg; break;
+            case 'p': workers = atoi(optarg); break;
+            case 't': threads = optarg; break;
+            default: error_handler("Использование: ./parent [-c БАЙТ] [-p ЧИСЛО_WORKER] [-t ПОТОКОВ]");
+        }
+    }
+    if (workers < 0 || workers > MAX_WORKERS) {
+        error_handler("Ошибка: неверное число worker");
+    }
+
+    uint32_t spin_limit = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? RING_SPIN_LIMIT : 0;
+    if (workers > 0) {
+        RunPool(workers, cache_budget, threads, spin_limit);
         exit(EXIT_SUCCESS);
     }
+
+    char filename[BUFFER_SIZE];
+    const char *prompt = "Введите имя файла: ";
+    write(STDOUT_FILENO, prompt, strlen(prompt));
+    bytesRead = read(STDIN_FILENO, filename, sizeof(filename) - 1);
+    if (bytesRead <= 0) {
+        error_handler("Ошибка чтения имени файла");
+    }
+    filename[bytesRead] = '\0';
+
+    size_t len = strlen(filename);
+    if (len > 0 && filename[len - 1] == '\n') {
+        filename[len - 1] = '\0';
+    }
+
+    ring = CreateChildRing(RingCapacity(filename), &memfd, &ring_size, spin_limit);
+    // read оставил место под завершающий ноль, так что имя короче BUFFER_SIZE.
+    memcpy(ring->filename, filename, strlen(filename) + 1);
+
+    pid_t child_pid = SpawnChild(memfd, -1, -1, cache_budget, threads);
+    close(memfd);
+    DrainJob(ring, child_pid);
+    if (waitpid(child_pid, NULL, 0) == -1) {
+        error_handler("Ошибка ожидания дочернего процесса");
+    }
+#ifdef LAB3_STATS
+    ReportStats(&ring, 1);
+#endif
+
+    munmap(ring, ring_size);
+    exit(EXIT_SUCCESS);
 }
@@ -0,0 +1,242 @@
+#ifndef SHARED_H
+#define SHARED_H
+
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// Раскладка разделяемой памяти между parent и child.
+// Результаты идут через кольцевой буфер с одним писателем (child) и одним читателем (parent):
+// child продвигает head, parent -- tail, поэтому обоим хватает атомарных load/store без блокировок.
+// head и tail лежат в разных кэш-линиях, чтобы стороны не сбрасывали друг другу строку кэша.
+// Ожидание -- тоже внутри сегмента: короткий спин, затем futex на самом индексе кольца.
+//
+// Данные кольца -- плотно уложенные записи [uint32 длина][текст], выровненные на 4 байта; head и tail --
+// смещения в байтах. Запись не разрывается на границе: остаток до конца помечается RECORD_WRAP.
+// Результаты одного файла заканчиваются записью RECORD_END.
+// Сегмент -- memfd, который child получает открытым на SHARED_FD, поэтому имени в /dev/shm нет вовсе.
+//
+// В режиме пула (-p K) у каждого worker своё кольцо, а имена файлов раздаются через общую очередь
+// заданий JobQueue (memfd на JOBS_FD).
+
+#define SHARED_FD 3
+#define JOBS_FD 4
+#define BUFFER_SIZE 1024
+#define CACHE_LINE 64
+#define RING_MIN_BYTES (16 * 1024)
+#define RING_MAX_BYTES (4 * 1024 * 1024)
+#define RING_DEFAULT_BYTES (1024 * 1024)
+#define RING_POOL_BYTES (256 * 1024)
+#define RING_HUGE_PAGE (2 * 1024 * 1024)
+#define RING_SPIN_LIMIT 1024
+#define RING_WAIT_TIMEOUT_NS (50 * 1000 * 1000)
+#define RECORD_WRAP UINT32_MAX
+#define RECORD_END (UINT32_MAX - 1)
+#define RECORD_SIZE(length) ((sizeof(uint32_t) + (length) + 3) & ~(uint32_t)3)
+#define JOB_SLOTS 64
+#define MAX_WORKERS 64
+
+// Замеры задержек (make STATS=1). Без LAB3_STATS макросы ниже раскрываются в пустоту, а блока
+// статистики в заголовке кольца нет совсем. Гистограммы логарифмические: на каждую степень двойки
+// наносекунд по STAT_SUB_BUCKETS корзин, так что перцентили точны примерно до 25%.
+// Разбор строк и передача записей замеряются выборочно, раз в STAT_SAMPLE_EVERY событий; передача
+// считается по записям, а не по публикациям, и вдобавок замеряется первая публикация каждого файла.
+#ifdef LAB3_STATS
+#define STAT_SUB_BITS 2
+#define STAT_SUB_BUCKETS (1 << STAT_SUB_BITS)
+#define STAT_BUCKETS (64 * STAT_SUB_BUCKETS)
+#define STAT_SAMPLE_EVERY 64
+
+typedef enum {
+    STAT_OPEN,
+    STAT_PARSE,
+    STAT_RING_WRITE,
+    STAT_PRODUCER_WAIT,
+    STAT_CONSUMER_WAIT,
+    STAT_OUTPUT,
+    STAT_HANDOFF,
+    STAT_STAGES
+} StatStage;
+
+typedef struct {
+    uint64_t count;
+    uint64_t max;
+    uint64_t buckets[STAT_BUCKETS];
+} StatHistogram;
+
+// Гистограммы пишет та сторона, которой принадлежит этап; потоки разбора child -- атомарно.
+// handoff_head/handoff_ns -- последняя выборочная публикация child под seqlock handoff_seq: parent,
+// увидев head не меньше handoff_head, считает задержку передачи этой записи.
+typedef struct {
+    StatHistogram stages[STAT_STAGES];
+    _Alignas(CACHE_LINE) uint32_t handoff_seq;
+    uint32_t handoff_head;
+    uint64_t handoff_ns;
+} LatencyStats;
+#endif
+
+typedef struct {
+    _Alignas(CACHE_LINE) uint32_t head;
+    _Alignas(CACHE_LINE) uint32_t tail;
+    // Счётчики спящих на futex меняются редко, поэтому проверка после каждой публикации почти бесплатна.
+    // Спящий parent будят не на каждую запись, а когда head дойдёт до consumer_wake_at или файл закончится.
+    _Alignas(CACHE_LINE) uint32_t consumer_waiting;
+    uint32_t consumer_wake_at;
+    uint32_t producer_waiting;
+    // На одном ядре спин только отнимает время у другой стороны, поэтому parent выставляет 0.
+    uint32_t spin_limit;
+    // Степень двойки; сегмент -- заголовок плюс capacity байт данных.
+    uint32_t capacity;
+#ifdef LAB3_STATS
+    _Alignas(CACHE_LINE) LatencyStats stats;
+#endif
+    _Alignas(CACHE_LINE) char filename[BUFFER_SIZE];
+    _Alignas(CACHE_LINE) char data[];
+} SharedRing;
+
+// Задание пула. worker -- номер взявшего его worker плюс один; 0, пока задание никто не взял.
+typedef struct {
+    uint32_t worker;
+    char filename[BUFFER_SIZE];
+} Job;
+
+// Очередь заданий: parent -- единственный писатель submitted, worker забирают задания CAS по claimed.
+// Слот переиспользуется, только когда parent напечатал результаты лежавшего в нём задания.
+typedef struct {
+    _Alignas(CACHE_LINE) uint32_t submitted;
+    uint32_t shutdown;
+    _Alignas(CACHE_LINE) uint32_t claimed;
+    _Alignas(CACHE_LINE) uint32_t workers_waiting;
+    uint32_t parent_waiting;
+    uint32_t spin_limit;
+    _Alignas(CACHE_LINE) Job jobs[JOB_SLOTS];
+} JobQueue;
+
+static inline void FutexWait(uint32_t *word, uint32_t expected, const struct timespec *timeout) {
+    syscall(SYS_futex, word, FUTEX_WAIT, expected, timeout, NULL, 0);
+}
+
+static inline void FutexWake(uint32_t *word) {
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// Ждёт, пока *word отличается от expected или поднят *stop (если задан). Возвращается и по тайм-ауту,
+// чтобы вызывающий мог проверить, жива ли другая сторона; условие после возврата нужно перепроверить.
+// *waiting -- число спящих, поэтому на одном слове могут ждать сразу несколько процессов.
+static inline void RingWait(uint32_t spin_limit, uint32_t *word, uint32_t expected, uint32_t *waiting, uint32_t *stop) {
+    for (unsigned spins = 0; spins < spin_limit; spins++) {
+        if (__atomic_load_n(word, __ATOMIC_ACQUIRE) != expected || (stop && __atomic_load_n(stop, __ATOMIC_ACQUIRE))) {
+            return;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    // Счётчик растёт до последней проверки: либо мы увидим новое значение, либо RingNotify увидит счётчик.
+    __atomic_add_fetch(waiting, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(word, __ATOMIC_SEQ_CST) == expected && !(stop && __atomic_load_n(stop, __ATOMIC_SEQ_CST))) {
+        struct timespec timeout = {0, RING_WAIT_TIMEOUT_NS};
+        FutexWait(word, expected, &timeout);
+    }
+    __atomic_sub_fetch(waiting, 1, __ATOMIC_RELAXED);
+}
+
+// Вызывается после изменения *word (или *stop): будит другую сторону, только если она уснула.
+static inline void RingNotify(uint32_t *word, uint32_t *waiting) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(waiting, __ATOMIC_RELAXED)) {
+        FutexWake(word);
+    }
+}
+
+#ifdef LAB3_STATS
+static inline uint64_t StatNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static inline unsigned StatBucket(uint64_t ns) {
+    if (ns < STAT_SUB_BUCKETS) {
+        return ns;
+    }
+    unsigned exponent = 63 - __builtin_clzll(ns);
+    return exponent * STAT_SUB_BUCKETS + ((ns >> (exponent - STAT_SUB_BITS)) & (STAT_SUB_BUCKETS - 1));
+}
+
+// Верхняя граница значений, попадающих в корзину bucket.
+static inline uint64_t StatBucketLimit(unsigned bucket) {
+    if (bucket < STAT_SUB_BUCKETS) {
+        return bucket;
+    }
+    unsigned exponent = bucket / STAT_SUB_BUCKETS;
+    uint64_t sub = bucket % STAT_SUB_BUCKETS;
+    return ((STAT_SUB_BUCKETS + sub + 1) << (exponent - STAT_SUB_BITS)) - 1;
+}
+
+static inline void StatRecord(StatHistogram *histogram, uint64_t ns, uint64_t weight) {
+    __atomic_fetch_add(&histogram->count, weight, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->buckets[StatBucket(ns)], weight, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+    while (ns > max && !__atomic_compare_exchange_n(&histogram->max, &max, ns, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+// Сдвигает счётчик выборки на count событий; истина, если при этом пройдена граница выборки.
+static inline int StatSampledBy(unsigned *counter, unsigned count) {
+    unsigned before = *counter;
+    *counter += count;
+    return before / STAT_SAMPLE_EVERY != *counter / STAT_SAMPLE_EVERY;
+}
+
+// Вызывается child перед публикацией head.
+static inline void StatStampHandoff(LatencyStats *stats, uint32_t head) {
+    __atomic_store_n(&stats->handoff_seq, stats->handoff_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&stats->handoff_head, head, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->handoff_ns, StatNow(), __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->handoff_seq, stats->handoff_seq + 1, __ATOMIC_RELEASE);
+}
+
+// Вызывается parent, увидевшим head; каждую выборку учитывает один раз.
+static inline void StatTakeHandoff(LatencyStats *stats, uint32_t tail, uint32_t head, uint32_t *taken_seq) {
+    uint32_t seq = __atomic_load_n(&stats->handoff_seq, __ATOMIC_ACQUIRE);
+    if ((seq & 1) || seq == *taken_seq) {
+        return;
+    }
+    uint32_t sample_head = __atomic_load_n(&stats->handoff_head, __ATOMIC_RELAXED);
+    uint64_t sample_ns = __atomic_load_n(&stats->handoff_ns, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&stats->handoff_seq, __ATOMIC_RELAXED) != seq) {
+        return;
+    }
+    if (sample_head - tail - 1 < head - tail) {
+        uint64_t now = StatNow();
+        StatRecord(&stats->stages[STAT_HANDOFF], now > sample_ns ? now - sample_ns : 0, 1);
+        *taken_seq = seq;
+    }
+}
+
+#define STAT_DECLARE(name) uint64_t name
+#define STAT_START(name) ((name) = StatNow())
+#define STAT_STOP(ring, stage, name) StatRecord(&(ring)->stats.stages[stage], StatNow() - (name), 1)
+#define STAT_SAMPLED(counter) ((++(counter) & (STAT_SAMPLE_EVERY - 1)) == 0)
+#define STAT_STAMP_HANDOFF(ring, head, counter, records, first) \
+    do { \
+        if (StatSampledBy(&(counter), (records)) || (first)) StatStampHandoff(&(ring)->stats, (head)); \
+    } while (0)
+#define STAT_TAKE_HANDOFF(ring, tail, head, taken_seq) StatTakeHandoff(&(ring)->stats, (tail), (head), &(taken_seq))
+#else
+#define STAT_DECLARE(name)
+#define STAT_START(name) ((void)0)
+#define STAT_STOP(ring, stage, name) ((void)0)
+#define STAT_SAMPLED(counter) 0
+#define STAT_STAMP_HANDOFF(ring, head, counter, records, first) ((void)(records), (void)(first))
+#define STAT_TAKE_HANDOFF(ring, tail, head, taken_seq) ((void)(taken_seq))
+#endif
+
+#endif